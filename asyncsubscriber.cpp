@@ -0,0 +1,190 @@
+#include "asyncsubscriber.h"
+#include <algorithm>
+#include <cassert>
+
+// entries a coalesced batch can hold before more are dropped
+static const size_t MaxHeldEntries = 64 * 1024;
+
+AsyncSubscriber::AsyncSubscriber(Handler handler, Policy policy, size_t capacity)
+	: handler_(handler), policy_(policy), queue_(capacity), free_(capacity), numHeld_(0), exiting_(false)
+	, batches_(0), entries_(0), dropped_(0), lag_(0)
+{
+	heldLock_.clear();
+	wakeEvent_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	thread_ = std::thread([this]() { Run(); });
+}
+
+AsyncSubscriber::~AsyncSubscriber()
+{
+	Stop();
+	CloseHandle(wakeEvent_);
+}
+
+void AsyncSubscriber::Stop()
+{
+	for (auto& connection : connections_)
+		connection.disconnect();
+	connections_.clear();
+
+	exiting_ = true;
+	SetEvent(wakeEvent_);
+	assert(thread_.get_id() != std::this_thread::get_id());
+	if (thread_.joinable())
+		thread_.join();
+
+	BatchPtr batch;
+	while (queue_.TryPop(batch))
+		batch.reset();
+	Spinlock lock(heldLock_);
+	held_.clear();
+	numHeld_ = 0;
+}
+
+void AsyncSubscriber::Subscribe(const LogFilePtr& file, int tag)
+{
+	// the log only tracks us, a call that's under way when we're stopped holds a
+	// reference until it's done and any after it are skipped
+	LogEntriesSignal::slot_type slot([this, tag](LogFilePtr file, const LogEntrySpan& entries) {
+		Post(file, tag, entries);
+	});
+	slot.track_foreign(std::weak_ptr<AsyncSubscriber>(shared_from_this()));
+	connections_.push_back(file->Subscribe(slot));
+}
+
+AsyncSubscriber::Stats AsyncSubscriber::GetStats() const
+{
+	Stats stats;
+	stats.depth = queue_.Size() + numHeld_.load(std::memory_order_relaxed);
+	stats.capacity = queue_.Capacity();
+	stats.batches = batches_.load(std::memory_order_relaxed);
+	stats.entries = entries_.load(std::memory_order_relaxed);
+	stats.dropped = dropped_.load(std::memory_order_relaxed);
+	stats.lag = lag_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+AsyncSubscriber::BatchPtr AsyncSubscriber::NewBatch(const LogFilePtr& file, int tag)
+{
+	BatchPtr batch;
+	if (!free_.TryPop(batch))
+		batch.reset(new Batch);
+	batch->file = file;
+	batch->source = file.get();
+	batch->tag = tag;
+	batch->count = 0;
+	batch->queued = Clock::now();
+	return batch;
+}
+
+// copies entries onto the end of the batch up to max entries, returns how many didn't fit
+size_t AsyncSubscriber::Append(Batch& batch, const LogEntrySpan& entries, size_t max)
+{
+	size_t n = std::min(entries.size(), max > batch.count ? max - batch.count : 0);
+	if (batch.entries.size() < batch.count + n)
+		batch.entries.resize(batch.count + n);
+	std::copy(entries.begin(), entries.begin() + n, batch.entries.begin() + batch.count);
+	batch.count += n;
+	return entries.size() - n;
+}
+
+void AsyncSubscriber::Post(const LogFilePtr& file, int tag, const LogEntrySpan& entries)
+{
+	if (entries.empty() || exiting_)
+		return;
+
+	// once a log's entries are held back they're added to what's held, so they stay in order
+	if (policy_ == Policy::coalesce && numHeld_.load(std::memory_order_acquire) > 0) {
+		Spinlock lock(heldLock_);
+		auto held = std::find_if(held_.begin(), held_.end(), [&](const BatchPtr& batch) {
+			return batch->source == file.get() && batch->tag == tag;
+		});
+		if (held != held_.end()) {
+			dropped_ += Append(**held, entries, MaxHeldEntries);
+			if (queue_.TryPush(*held)) {
+				held_.erase(held);
+				numHeld_ = held_.size();
+				SetEvent(wakeEvent_);
+			}
+			return;
+		}
+	}
+
+	auto batch = NewBatch(file, tag);
+	Append(*batch, entries, entries.size());
+	for (;;) {
+		if (queue_.TryPush(batch)) {
+			SetEvent(wakeEvent_);
+			return;
+		}
+		switch (policy_) {
+		case Policy::drop:
+			dropped_ += batch->count;
+			batch->file.reset();
+			free_.TryPush(batch);
+			return;
+
+		case Policy::coalesce:
+		{
+			Spinlock lock(heldLock_);
+			held_.push_back(std::move(batch));
+			numHeld_ = held_.size();
+			SetEvent(wakeEvent_);
+			return;
+		}
+
+		case Policy::block:
+			SetEvent(wakeEvent_);
+			if (exiting_)
+				return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			break;
+		}
+	}
+}
+
+void AsyncSubscriber::Run()
+{
+	while (!exiting_) {
+		BatchPtr batch;
+		if (queue_.TryPop(batch)) {
+			Handle(std::move(batch));
+			continue;
+		}
+
+		// anything in the queue from a log with held batches came before them, so they're
+		// only taken once the queue is empty, a log with held batches only adds to the
+		// queue under the lock so it can't refill in between
+		if (numHeld_.load(std::memory_order_acquire) > 0) {
+			std::vector<BatchPtr> held;
+			{
+				Spinlock lock(heldLock_);
+				if (queue_.Size() == 0) {
+					held.swap(held_);
+					numHeld_ = 0;
+				}
+			}
+			for (auto& batch : held)
+				Handle(std::move(batch));
+			continue;
+		}
+		WaitForSingleObject(wakeEvent_, 100);
+	}
+}
+
+void AsyncSubscriber::Handle(BatchPtr batch)
+{
+	auto file = batch->file.lock();
+	try {
+		if (file)
+			handler_(file, batch->tag, LogEntrySpan(batch->entries.data(), batch->count));
+	}
+	catch (std::exception& e) {
+		DLog("Subscriber failed - %s\n", e.what());
+	}
+	lag_ = (int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - batch->queued).count();
+	batches_++;
+	entries_ += batch->count;
+
+	batch->file.reset();
+	free_.TryPush(batch);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "logfile.h"
+#include "boundedqueue.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Runs a subscriber on its own thread so whatever it does with the entries
+// doesn't hold up the tailer. Each batch a log flushes is copied and queued,
+// and the policy says what happens when the subscriber falls behind and the
+// queue is full: the tailer waits, the batch is dropped and counted, or the
+// batches back up outside the queue and are merged until there's room.
+class AsyncSubscriber : public std::enable_shared_from_this<AsyncSubscriber>
+{
+	typedef std::chrono::steady_clock Clock;
+
+public:
+	enum class Policy { block, drop, coalesce };
+	typedef std::function<void(const LogFilePtr& file, int tag, const LogEntrySpan& entries)> Handler;
+
+	struct Stats
+	{
+		size_t depth = 0;			// batches waiting, including any held back to coalesce
+		size_t capacity = 0;
+		uint64_t batches = 0;		// handled so far
+		uint64_t entries = 0;
+		uint64_t dropped = 0;		// entries dropped because the queue was full
+		int lag = 0;				// milliseconds the last batch waited before it was handled
+	};
+
+	static const size_t DefaultCapacity = 256;
+
+	// create with make_shared, the owner has to Stop it before it lets the last reference go
+	AsyncSubscriber(Handler handler, Policy policy, size_t capacity = DefaultCapacity);
+	~AsyncSubscriber();
+
+	AsyncSubscriber(const AsyncSubscriber&) = delete;
+	AsyncSubscriber& operator=(const AsyncSubscriber&) = delete;
+
+	// subscribes to a log, the handler gets tag with its entries
+	void Subscribe(const LogFilePtr& file, int tag);
+	Stats GetStats() const;
+
+	// Disconnects from the logs and waits for the thread, the handler isn't called
+	// again once it returns and what's still queued is dropped. Called by the owner,
+	// never from the handler.
+	void Stop();
+
+private:
+	// a batch doesn't keep its log alive, it's skipped if the log has gone by the time it's handled
+	struct Batch
+	{
+		std::weak_ptr<LogFile> file;
+		const LogFile* source = nullptr;	// to tell which log it's from without locking file
+		int tag = 0;
+		std::vector<LogEntry> entries;	// reused, only the first count are in the batch
+		size_t count = 0;
+		Clock::time_point queued;
+	};
+	typedef std::unique_ptr<Batch> BatchPtr;
+
+	Handler handler_;
+	Policy policy_;
+	BoundedQueue<BatchPtr> queue_;
+	BoundedQueue<BatchPtr> free_;	// handled batches go back to the tailer to be filled again
+	std::vector<BatchPtr> held_;	// coalesced batches waiting for room, at most one per log and tag
+	mutable std::atomic_flag heldLock_;
+	std::atomic<size_t> numHeld_;
+
+	std::atomic<bool> exiting_;
+	HANDLE wakeEvent_;
+	std::thread thread_;
+	std::vector<boost::signals2::connection> connections_;
+
+	std::atomic<uint64_t> batches_;
+	std::atomic<uint64_t> entries_;
+	std::atomic<uint64_t> dropped_;
+	std::atomic<int> lag_;
+
+	void Post(const LogFilePtr& file, int tag, const LogEntrySpan& entries);
+	BatchPtr NewBatch(const LogFilePtr& file, int tag);
+	static size_t Append(Batch& batch, const LogEntrySpan& entries, size_t max);
+	void Run();
+	void Handle(BatchPtr batch);
+};
+
+typedef std::shared_ptr<AsyncSubscriber> AsyncSubscriberPtr;
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+// A fixed size queue any number of threads can push to and pop from without a
+// lock. Each cell has a sequence number that says whose turn it is, so a push
+// or pop only claims a cell when it's ready for it. The capacity is rounded up
+// to a power of two.
+template <typename T>
+class BoundedQueue
+{
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> cells_;
+	size_t mask_;
+	alignas(64) std::atomic<size_t> enqueue_;
+	alignas(64) std::atomic<size_t> dequeue_;
+
+public:
+	explicit BoundedQueue(size_t capacity)
+		: enqueue_(0), dequeue_(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		cells_.reset(new Cell[size]);
+		mask_ = size - 1;
+		for (size_t i = 0; i < size; i++)
+			cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	size_t Capacity() const { return mask_ + 1; }
+	// only a guide while other threads are pushing and popping
+	size_t Size() const
+	{
+		size_t dequeue = dequeue_.load(std::memory_order_relaxed);
+		size_t enqueue = enqueue_.load(std::memory_order_relaxed);
+		return enqueue > dequeue ? enqueue - dequeue : 0;
+	}
+
+	// value is only moved from if there was room
+	bool TryPush(T& value)
+	{
+		size_t pos = enqueue_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells_[pos & mask_];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = std::move(value);
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;	// full
+			else
+				pos = enqueue_.load(std::memory_order_relaxed);
+		}
+	}
+
+	bool TryPop(T& value)
+	{
+		size_t pos = dequeue_.load(std::memory_order_relaxed);
+		for (;;) {
+			auto& cell = cells_[pos & mask_];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = std::move(cell.value);
+					cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;	// empty
+			else
+				pos = dequeue_.load(std::memory_order_relaxed);
+		}
+	}
+};
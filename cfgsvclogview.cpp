@@ -39,6 +39,19 @@ void CfgSvcLogView::SetSearchPattern(const std::string& searchPattern)
 	}
 }
 
+bool CfgSvcLogView::GotoTime(int time)
+{
+	LogSnapshot snapshot(file_);
+	int idx = snapshot.FindTimeOfDay(time);
+	if (idx < 0)
+		return false;
+	row_ = idx;
+	tail_ = false;
+	file_->Pause(!tail_);
+	SetPosition();
+	return true;
+}
+
 bool CfgSvcLogView::Update(int c)
 {
 	const int pageSize = LINES - 6;
@@ -123,60 +136,60 @@ void CfgSvcLogView::Resize()
 
 void CfgSvcLogView::Render()
 {
-	LockBuffer lock(file_);
+	LogSnapshot snapshot(file_);
 	int maxy, maxx;
 	getmaxyx(*win_, maxy, maxx);
-	int maxEntries = std::min(maxy, file_->NumLines());
+	int maxEntries = std::min(maxy, snapshot.NumLines());
 
 	int tsWidth = 39; // "  [0HM03ECM9KP9H:00000001] 14:21:28.477  "
 	int margin = 2;
 	int bodyWidth = maxx - tsWidth - margin;
 
 	if (tail_)
-		row_ = file_->NumLines() < maxy ? 0 : file_->NumLines() - maxy;
+		row_ = snapshot.NumLines() < maxy ? 0 : snapshot.NumLines() - maxy;
 	int start = row_;
 
-	std::string lastTimestamp;
+	int lastSecond = -1;
 	std::string id;
 	int tidCtr = 0;
 	int lastNoneEmptyLine = 0;
 	int lastMarker = 0;
 
 	for (int i = 0; i < maxy; start++) {
-		if (start < file_->NumLines()) {
-			auto entry = file_->GetEntry(start);
+		LogEntryView entry;
+		if (snapshot.GetEntry(start, entry)) {
 			//if (filter_ && Filter(entry))
 			//	continue;
 
-			if (entry->type == MessageType::system) {
+			if (entry.type == MessageType::system) {
 				win_->AttrOn(COLOR_PAIR(LM_SYSTEM_MESSAGE));
 				win_->MvAddch(i, 1, ACS_DIAMOND);
-				win_->PrintF(i, margin, (int)entry->body.size() + 1, " %s", entry->body.c_str());
+				win_->PrintF(i, margin, (int)entry.body.size() + 1, " %s", entry.body.c_str());
 				win_->AttrOff(COLOR_PAIR(LM_SYSTEM_MESSAGE));
 				win_->ClearToEol();
 				continue;
 			}
-			else if (entry->type == MessageType::cfgSvc) {
+			else if (entry.type == MessageType::cfgSvc) {
 				win_->AttrOn(COLOR_PAIR(LM_THREAD_ID));
-				win_->PrintF(i, margin, 25, "[%22s] ", entry->id.c_str());
+				win_->PrintF(i, margin, 25, "[%22s] ", entry.id.c_str());
 				win_->AttrOff(COLOR_PAIR(LM_THREAD_ID));
-				auto ts = entry->time.substr(0, 8);
+				int second = entry.time < 0 ? -1 : entry.time / 1000;
 				bool resetBold = false;
-				if (!displayDuration_ && !lastTimestamp.empty() && ts != lastTimestamp
-					|| displayDuration_ && entry->duration > ts::seconds(1)) {
+				if (!displayDuration_ && lastSecond >= 0 && second != lastSecond
+					|| displayDuration_ && entry.duration > 1000) {
 					// highlight the start of a new second, but don't do it for the 1st line, otherwise, that's always bold
 					win_->AttrOn(A_BOLD);
 					resetBold = true;
 				}
 				win_->AttrOn(COLOR_PAIR(LM_TIMESTAMP));
 				if (displayDuration_) {
-					win_->PrintF(i, margin + 25, tsWidth - 25, "%02d:%02d:%02d.%03d", entry->duration.hours(),
-						entry->duration.minutes(), entry->duration.seconds(), entry->duration.fractional_seconds() / 1000);
+					win_->PrintF(i, margin + 25, tsWidth - 25, "%02d:%02d:%02d.%03d", entry.duration / 3600000,
+						entry.duration / 60000 % 60, entry.duration / 1000 % 60, entry.duration % 1000);
 				}
 				else
-					win_->PrintF(i, margin + 25, tsWidth - 25, "%s", entry->time.c_str());
+					win_->PrintF(i, margin + 25, tsWidth - 25, "%s", TimeText(entry.time).c_str());
 				win_->AttrOff(COLOR_PAIR(LM_TIMESTAMP));
-				lastTimestamp = ts;
+				lastSecond = second;
 				if (resetBold)
 					win_->AttrOff(A_BOLD);
 			}
@@ -187,8 +200,8 @@ void CfgSvcLogView::Render()
 			if (col_ > 0)
 				win_->MvAddch(i, margin + tsWidth - 1, ACS_VLINE);
 
-			if (col_ < (int)entry->body.size() && !(filter_ && Filter(entry))) {
-				RenderBody(i, tsWidth + margin, bodyWidth, entry->body.c_str(), col_);
+			if (col_ < (int)entry.body.size() && !(filter_ && Filter(entry))) {
+				RenderBody(i, tsWidth + margin, bodyWidth, entry.body.c_str(), col_);
 			}
 			else
 				win_->PrintF(i, tsWidth + margin, bodyWidth, "");
@@ -196,14 +209,14 @@ void CfgSvcLogView::Render()
 
 			// draw line markers
 			// thread the tid's, we always draw the current line 
-			if (id == entry->id && !id.empty()) {
+			if (id == entry.id && !id.empty()) {
 				if (tidCtr++ == 1) {
 					// we have the same tid as the previous line, and the previous line was the first one
 					win_->MvAddch(i - 1, 1, lastMarker = ACS_ULCORNER);
 				}
 				win_->MvAddch(i, 1, lastMarker = ACS_VLINE);
 			}
-			else if (id != entry->id && !entry->id.empty()) {
+			else if (id != entry.id && !entry.id.empty()) {
 				// we have a new tid and the previous one wasn't unknown
 				if (!id.empty()) {
 					if (tidCtr == 1)
@@ -213,10 +226,10 @@ void CfgSvcLogView::Render()
 				}
 				// start accumulating again
 				tidCtr = 1;
-				id = entry->id;
+				id = entry.id.str();
 				win_->MvAddch(i, 1, lastMarker = ACS_ULCORNER);
 			}
-			else if (!id.empty() && entry->id.empty()) {
+			else if (!id.empty() && entry.id.empty()) {
 				// this line doesn't have tid, consider it as part of the previous tid
 				tidCtr++;
 				win_->MvAddch(i, 1, lastMarker = ACS_VLINE);
@@ -295,16 +308,18 @@ void CfgSvcLogView::SetPosition()
 		return;
 
 	ui_->SetStatus(0, 0, "");
-	ui_->SetStatus(1, LM_STATUS_BAR, "  %-s", file_->Filename().string().c_str());
+	const double MB = 1024.0 * 1024.0;
+	ui_->SetStatus(1, LM_STATUS_BAR, "  %-s  (%d lines, %.1f of %.1f MB)", file_->Filename().string().c_str(),
+		file_->NumLines(), file_->BufferBytes() / MB, file_->GetBudget() / MB);
 	ui_->SetStatus(2, tail_ ? LM_STATUS_TAIL : LM_STATUS_PAUSED, " [%s] %s", tail_ ? "Tail" : "Paused", !tail_ ? " press enter to continue" : "");
 }
 
-bool CfgSvcLogView::Filter(std::shared_ptr<LogEntry> entry) const
+bool CfgSvcLogView::Filter(const LogEntryView& entry) const
 {
-	if (entry->type == MessageType::system)
+	if (entry.type == MessageType::system)
 		return false;
 	for (const auto& pat : filterPatterns_) {
-		if (boost::regex_match(entry->body, pat))
+		if (boost::regex_match(entry.body.begin(), entry.body.end(), pat))
 			return true;
 	}
 	return false;
@@ -31,10 +31,11 @@ public:
 	virtual void Resize();
 	virtual void Render();
 	virtual void SetSearchPattern(const std::string& searchPattern);
+	virtual bool GotoTime(int time);
 	void SetPosition();
 
 private:
 	void RenderBody(int y, int x, int width, const std::string& body, int offset);
 	void ColorizeMatch(int y, int x, int width, const std::string& body, int offset, const boost::regex& pattern, int color);
-	bool Filter(std::shared_ptr<LogEntry> entry) const;
+	bool Filter(const LogEntryView& entry) const;
 };
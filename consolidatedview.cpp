@@ -95,16 +95,19 @@ void ConsolidatedLogView::RefreshBuffer()
 	std::vector<std::shared_ptr<LogEntryEx>> tmp;
 	for (int i = 0; i < (int)files_.size(); i++) {
 		auto file = files_[i];
-		LockBuffer lock(file);
-		int j = std::max(file->NumLines() - N - 1, 0);
-		for (; j < file->NumLines(); j++) {
+		LogSnapshot snapshot(file);
+		int j = std::max(snapshot.NumLines() - N - 1, 0);
+		for (; j < snapshot.NumLines(); j++) {
+			LogEntryView line;
+			if (!snapshot.GetEntry(j, line))
+				continue;
 			auto entry = std::make_shared<LogEntryEx>();
-			*entry = *file->GetEntry(j);
+			*entry = line.Copy();
 			entry->filename = file->Filename().filename().string();
 			tmp.push_back(entry);
 		}
 
-		if (file->NumLines() > 0) {
+		if (snapshot.NumLines() > 0) {
 			// add an empty entry per log file to separate them
 			auto entry = std::make_shared<LogEntryEx>();
 			entry->type = MessageType::separator;
@@ -150,7 +153,7 @@ void ConsolidatedLogView::Render()
 				bool highlight = entry->timestamp + 3 > time(nullptr);
 				if (highlight)
 					win_->AttrOn(A_BOLD);
-				win_->PrintF(i, 28, 12, "%s ", entry->time.c_str());
+				win_->PrintF(i, 28, 12, "%s ", TimeText(entry->time).c_str());
 				win_->PrintF(i, 41, (int)entry->body.size(), "%s", entry->body.c_str());
 				if (highlight)
 					win_->AttrOff(A_BOLD);
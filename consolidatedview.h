@@ -13,6 +13,7 @@ struct LogEntryEx : LogEntry
 		id = rhs.severity;
 		tid = rhs.tid;
 		time = rhs.time;
+		day = rhs.day;
 		timestamp = rhs.timestamp;
 		type = rhs.type;
 		body = rhs.body;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "logentry.h"
+#include "logtime.h"
+
+// Parses the "tid HH:MM:SS.mmm body" format used by the controller logs, the same
+// format as LogFile's regex "^(\d+)\s(\d{2}:\d{2}:\d{2}\.\d{3})\s(.*)$". Returns
+// false if the line doesn't match exactly or the time is out of range, in which
+// case the caller falls back to the regex.
+inline bool ParseControllerLine(const char* line, size_t len, LogEntry& entry)
+{
+	// same set as \s in the C locale
+	auto isSpace = [](char c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+
+	const char* p = line;
+	const char* end = line + len;
+	unsigned tid = 0;
+	while (p < end && (unsigned char)(*p - '0') <= 9)
+		tid = tid * 10 + (*p++ - '0');
+
+	// at least one digit, then whitespace + "HH:MM:SS.mmm" + whitespace
+	if (p == line || end - p < 14 || !isSpace(p[0]) || !isSpace(p[13]))
+		return false;
+	int time = ParseTimeOfDay(p + 1);
+	if (time < 0)
+		return false;
+
+	entry.type = MessageType::normal;
+	entry.tid = (int)tid;
+	entry.time = time;
+	entry.body.assign(p + 14, end);
+	return true;
+}
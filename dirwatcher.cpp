@@ -0,0 +1,76 @@
+#include "dirwatcher.h"
+
+DirectoryWatcher::DirectoryWatcher(const fs::path& dir)
+	: dir_(dir), buffer_(16 * 1024)
+{
+	memset(&overlapped_, 0, sizeof(overlapped_));
+	event_ = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	dirHandle_ = CreateFile(dir.string().c_str(), FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (event_ == nullptr || dirHandle_ == INVALID_HANDLE_VALUE) {
+		DLog("Cannot watch directory %s, err=%d\n", dir.string().c_str(), (int)GetLastError());
+		return;
+	}
+	Start();
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (dirHandle_ != INVALID_HANDLE_VALUE) {
+		if (pending_) {
+			DWORD bytes;
+			CancelIo(dirHandle_);
+			GetOverlappedResult(dirHandle_, &overlapped_, &bytes, TRUE);
+		}
+		CloseHandle(dirHandle_);
+	}
+	if (event_)
+		CloseHandle(event_);
+}
+
+bool DirectoryWatcher::Start()
+{
+	ResetEvent(event_);
+	overlapped_.hEvent = event_;
+	pending_ = ReadDirectoryChangesW(dirHandle_, buffer_.data(), (DWORD)(buffer_.size() * sizeof(DWORD)), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+		nullptr, &overlapped_, nullptr) != FALSE;
+	if (!pending_)
+		DLog("ReadDirectoryChangesW failed for %s, err=%d\n", dir_.string().c_str(), (int)GetLastError());
+	return pending_;
+}
+
+bool DirectoryWatcher::GetChanges(std::vector<std::string>& names)
+{
+	if (!pending_)
+		return false;
+
+	DWORD bytes = 0;
+	if (!GetOverlappedResult(dirHandle_, &overlapped_, &bytes, FALSE)) {
+		if (GetLastError() == ERROR_IO_INCOMPLETE)
+			return true;	// nothing yet
+		pending_ = false;
+		Start();
+		return false;
+	}
+	pending_ = false;
+
+	// bytes is 0 when the buffer overflowed and the changes were dropped
+	bool complete = bytes > 0;
+	auto p = reinterpret_cast<const char*>(buffer_.data());
+	while (complete) {
+		auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+		char name[MAX_PATH];
+		int len = WideCharToMultiByte(CP_ACP, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)),
+			name, sizeof(name) - 1, nullptr, nullptr);
+		if (len > 0 && info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+			names.emplace_back(name, len);
+		if (info->NextEntryOffset == 0)
+			break;
+		p += info->NextEntryOffset;
+	}
+
+	Start();
+	return complete;
+}
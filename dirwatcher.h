@@ -0,0 +1,37 @@
+#pragma once
+
+#include "utils.h"
+#include <string>
+#include <vector>
+
+// Watches a directory for files being created, renamed or written to using
+// ReadDirectoryChangesW. The event handle is signalled when there are changes
+// to collect, so the tailer can wait on it with WaitForMultipleObjects.
+class DirectoryWatcher
+{
+	fs::path dir_;
+	HANDLE dirHandle_ = INVALID_HANDLE_VALUE;
+	HANDLE event_ = nullptr;
+	OVERLAPPED overlapped_;
+	std::vector<DWORD> buffer_;		// FILE_NOTIFY_INFORMATION must be DWORD aligned
+	bool pending_ = false;
+
+public:
+	DirectoryWatcher(const fs::path& dir);
+	~DirectoryWatcher();
+
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	const fs::path& Directory() const { return dir_; }
+	bool IsValid() const { return pending_; }
+	HANDLE GetEvent() const { return event_; }
+
+	// Collects the names of the files that changed since the last call and
+	// re-arms the watch. Returns false if the notification buffer overflowed,
+	// in which case the caller should assume every file has changed.
+	bool GetChanges(std::vector<std::string>& names);
+
+private:
+	bool Start();
+};
@@ -0,0 +1,4 @@
+#pragma once
+
+// printf style to the debugger's output, defined in utils.cpp
+void DLog(const char* fmt, ...);
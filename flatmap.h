@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// An open addressing hash map from non-zero 64 bit keys, the slots are one flat
+// array searched with linear probing, so a lookup is a hash and usually a single
+// cache line. Erasing shifts the following entries back rather than leaving a
+// tombstone, so lookups never slow down as entries come and go.
+template <typename V>
+class FlatMap
+{
+	struct Slot
+	{
+		uint64_t key = 0;	// 0 for an empty slot
+		V value;
+	};
+
+	std::vector<Slot> slots_;
+	size_t size_ = 0;
+
+public:
+	FlatMap() : slots_(16) {}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	V* Find(uint64_t key)
+	{
+		for (size_t i = Home(key);; i = Next(i)) {
+			if (slots_[i].key == key)
+				return &slots_[i].value;
+			if (slots_[i].key == 0)
+				return nullptr;
+		}
+	}
+
+	const V* Find(uint64_t key) const
+	{
+		return const_cast<FlatMap*>(this)->Find(key);
+	}
+
+	// the value for key, default constructed if it wasn't there
+	V& operator[](uint64_t key)
+	{
+		if ((size_ + 1) * 4 > slots_.size() * 3)
+			Grow();
+		size_t i = Home(key);
+		for (; slots_[i].key != 0; i = Next(i)) {
+			if (slots_[i].key == key)
+				return slots_[i].value;
+		}
+		slots_[i].key = key;
+		size_++;
+		return slots_[i].value;
+	}
+
+	bool Erase(uint64_t key)
+	{
+		size_t i = Home(key);
+		for (; slots_[i].key != key; i = Next(i)) {
+			if (slots_[i].key == 0)
+				return false;
+		}
+		// move back anything after the hole that would no longer be found past it
+		for (size_t j = Next(i); slots_[j].key != 0; j = Next(j)) {
+			size_t home = Home(slots_[j].key);
+			if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+				slots_[i] = std::move(slots_[j]);
+				i = j;
+			}
+		}
+		slots_[i].key = 0;
+		slots_[i].value = V();
+		size_--;
+		return true;
+	}
+
+	template <typename F>
+	void ForEach(F&& f) const
+	{
+		for (const auto& slot : slots_) {
+			if (slot.key != 0)
+				f(slot.key, slot.value);
+		}
+	}
+
+private:
+	size_t Home(uint64_t key) const
+	{
+		// the ids are packed fields rather than random, mix them before taking the low bits
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdull;
+		key ^= key >> 33;
+		return (size_t)key & (slots_.size() - 1);
+	}
+
+	size_t Next(size_t i) const { return (i + 1) & (slots_.size() - 1); }
+
+	void Grow()
+	{
+		std::vector<Slot> slots(slots_.size() * 2);
+		slots.swap(slots_);
+		size_ = 0;
+		for (auto& slot : slots) {
+			if (slot.key != 0)
+				(*this)[slot.key] = std::move(slot.value);
+		}
+	}
+};
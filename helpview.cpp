@@ -17,6 +17,8 @@ HelpView::HelpView(MainUi* ui, std::shared_ptr<Window> win)
 		"  o       - open log file in editor",
 		"  q       - quit viewer",
 		"  /       - search for string",
+		"  :       - go to a time (HH:MM[:SS[.mmm]])",
+		"  tab     - next view, shift+tab for the previous one",
 		"  esc     - close help"
 	};
 }
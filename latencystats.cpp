@@ -0,0 +1,60 @@
+#include "latencystats.h"
+
+void LatencyStats::Record(Stage stage, int day, int time, int ms)
+{
+	int64_t minute = (int64_t)day * 24 * 60 + time / 60000;
+
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!minutes_.empty() && minute <= minutes_.back().minute - KeepMinutes)
+		return;
+
+	// the logs are parsed on their own threads, so a minute can turn up a little late
+	auto it = minutes_.end();
+	while (it != minutes_.begin() && (it - 1)->minute > minute)
+		--it;
+	if (it == minutes_.begin() || (it - 1)->minute != minute) {
+		it = minutes_.emplace(it);
+		it->minute = minute;
+	}
+	else {
+		--it;
+	}
+	it->stages[stage].Record(ms);
+
+	while (minutes_.front().minute <= minutes_.back().minute - KeepMinutes)
+		minutes_.pop_front();
+}
+
+void LatencyStats::Replace(Stage stage, int day, int time, int previous, int ms)
+{
+	int64_t minute = (int64_t)day * 24 * 60 + time / 60000;
+
+	std::lock_guard<std::mutex> guard(lock_);
+	for (auto it = minutes_.rbegin(); it != minutes_.rend() && it->minute >= minute; ++it) {
+		if (it->minute == minute) {
+			it->stages[stage].Remove(previous);
+			it->stages[stage].Record(ms);
+			return;
+		}
+	}
+}
+
+void LatencyStats::GetFigures(int minutes, Figures (&figures)[NumStages]) const
+{
+	LatencyHistogram totals[NumStages];
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		for (auto it = minutes_.rbegin(); it != minutes_.rend() && it->minute > minutes_.back().minute - minutes; ++it) {
+			for (int i = 0; i < NumStages; i++)
+				totals[i].Add(it->stages[i]);
+		}
+	}
+
+	for (int i = 0; i < NumStages; i++) {
+		figures[i].count = totals[i].Count();
+		figures[i].p50 = totals[i].Quantile(0.5);
+		figures[i].p90 = totals[i].Quantile(0.9);
+		figures[i].p99 = totals[i].Quantile(0.99);
+		figures[i].max = totals[i].Max();
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// A histogram of millisecond latencies in the HDR style: a power of two range is
+// split into SubBuckets equal buckets, so any value is held to within about 3%
+// and the counts take the same few KB whether the values are 5ms or 5 hours.
+class LatencyHistogram
+{
+	static const int SubBucketBits = 5;
+	static const int SubBuckets = 1 << SubBucketBits;
+	static const int NumBuckets = (31 - SubBucketBits + 1) * SubBuckets;	// enough for any int
+
+	uint32_t counts_[NumBuckets] = {};
+	uint64_t count_ = 0;
+	int max_ = 0;
+
+public:
+	void Record(int ms)
+	{
+		if (ms < 0)
+			return;
+		counts_[Bucket(ms)]++;
+		count_++;
+		if (ms > max_)
+			max_ = ms;
+	}
+
+	// takes back a value that was recorded, the max stays to within a bucket of the largest left
+	void Remove(int ms)
+	{
+		if (ms < 0)
+			return;
+		int bucket = Bucket(ms);
+		if (counts_[bucket] == 0)
+			return;
+		counts_[bucket]--;
+		count_--;
+		if (ms < max_ && Bucket(max_) != bucket)
+			return;
+		while (bucket >= 0 && counts_[bucket] == 0)
+			bucket--;
+		if (bucket < 0)
+			max_ = 0;
+		else if (Bucket(max_) != bucket)
+			max_ = Highest(bucket);
+	}
+
+	void Add(const LatencyHistogram& other)
+	{
+		for (int i = 0; i < NumBuckets; i++)
+			counts_[i] += other.counts_[i];
+		count_ += other.count_;
+		if (other.max_ > max_)
+			max_ = other.max_;
+	}
+
+	uint64_t Count() const { return count_; }
+	int Max() const { return max_; }
+
+	// the highest value that's the same as the one at the fraction through, 0 if there's none
+	int Quantile(double fraction) const
+	{
+		if (count_ == 0)
+			return 0;
+		uint64_t want = (uint64_t)(fraction * count_ + 0.5);
+		want = want < 1 ? 1 : want > count_ ? count_ : want;
+		uint64_t seen = 0;
+		for (int i = 0; i < NumBuckets; i++) {
+			seen += counts_[i];
+			if (seen >= want)
+				return Highest(i) < max_ ? Highest(i) : max_;
+		}
+		return max_;
+	}
+
+private:
+	// below 2 * SubBuckets each value has its own bucket, above that each power
+	// of two shares SubBuckets of them
+	static int Bucket(int ms)
+	{
+		int shift = 0;
+		while ((ms >> shift) >= 2 * SubBuckets)
+			shift++;
+		return shift * SubBuckets + (ms >> shift);
+	}
+
+	static int Highest(int bucket)
+	{
+		int shift = bucket < 2 * SubBuckets ? 0 : bucket / SubBuckets - 1;
+		int64_t highest = ((int64_t)(bucket - shift * SubBuckets) << shift) + ((int64_t)1 << shift) - 1;
+		return highest < INT32_MAX ? (int)highest : INT32_MAX;
+	}
+};
+
+// The time a message takes through each stage of MailMarshal, kept a minute at a
+// time by the log time the stage finished, for the last hour.
+class LatencyStats
+{
+public:
+	enum Stage { receiveToEngine, engineProcessing, engineToSend, NumStages };
+
+	struct Figures
+	{
+		uint64_t count = 0;
+		int p50 = 0;
+		int p90 = 0;
+		int p99 = 0;
+		int max = 0;
+	};
+
+	static const int KeepMinutes = 60;
+
+	// day and time are when the stage finished
+	void Record(Stage stage, int day, int time, int ms);
+
+	// a stage recorded at day and time took ms rather than previous after all, it
+	// stays in the same minute, and is let go if that minute has gone
+	void Replace(Stage stage, int day, int time, int previous, int ms);
+
+	// the stages over the last so many minutes of log time
+	void GetFigures(int minutes, Figures (&figures)[NumStages]) const;
+
+private:
+	struct Minute
+	{
+		int64_t minute;		// since 1970
+		LatencyHistogram stages[NumStages];
+	};
+
+	mutable std::mutex lock_;
+	std::deque<Minute> minutes_;	// in order, only the minutes with something in them
+};
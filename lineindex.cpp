@@ -0,0 +1,281 @@
+#include "lineindex.h"
+#include "logtime.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <emmintrin.h>
+#include <intrin.h>
+
+// each worker maps and scans a block at a time
+static const int64_t BlockSize = 16 * 1024 * 1024;
+// what's read at a time when extending the index or reading a line back
+static const DWORD ReadSize = 1024 * 1024;
+static const DWORD LineReadSize = 16 * 1024;
+static const size_t MaxLineLength = 1024 * 1024;
+static const size_t MaxParsed = 4096;
+
+LineIndex::LineIndex(const fs::path& path)
+	: path_(path), ready_(false), stop_(false)
+{
+	file_ = CreateFile(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	boost::system::error_code ec;
+	auto writeTime = fs::last_write_time(path, ec);
+	LocalDayAndTime(ec ? time(nullptr) : writeTime, day_, fileTime_);
+}
+
+LineIndex::~LineIndex()
+{
+	stop_ = true;
+	if (builder_.joinable())
+		builder_.join();
+	if (file_ != INVALID_HANDLE_VALUE)
+		CloseHandle(file_);
+}
+
+void LineIndex::Start()
+{
+	stop_ = true;
+	if (builder_.joinable())
+		builder_.join();
+	stop_ = false;
+	ready_ = false;
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		blocks_.clear();
+		lines_ = 0;
+		indexedTo_ = 0;
+	}
+	{
+		std::lock_guard<std::mutex> guard(parsedLock_);
+		parsed_.clear();
+		parsedLines_.clear();
+	}
+	builder_ = std::thread([this]() { Build(); });
+}
+
+uint64_t LineIndex::NumLines() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return lines_;
+}
+
+// Counts the newlines in data 16 bytes at a time, adding the start of every
+// Stride'th line to the block. base is the file offset of data.
+void LineIndex::Scan(const char* data, size_t len, int64_t base, Block& block)
+{
+	auto newline = [&](size_t pos) {
+		block.count++;
+		block.end = base + pos + 1;
+		if (block.count % Stride == 0)
+			block.offsets.push_back(block.end);
+	};
+
+	const __m128i nl = _mm_set1_epi8('\n');
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nl));
+		while (mask != 0) {
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			newline(i + bit);
+			mask &= mask - 1;
+		}
+	}
+	for (; i < len; i++) {
+		if (data[i] == '\n')
+			newline(i);
+	}
+}
+
+void LineIndex::Build()
+{
+	std::vector<Block> blocks;
+	MappedFile file;
+	if (file.Open(path_)) {
+		// split the file into blocks that end just after a newline, so every block starts on a line
+		int64_t size = file.Size();
+		for (int64_t pos = 0; pos < size && !stop_;) {
+			Block block;
+			block.begin = block.end = pos;
+			int64_t end = std::min(pos + BlockSize, size);
+			for (int64_t from = end - 1; end < size; from += LineReadSize) {
+				if (!file.Map(from, LineReadSize) || file.Length() == 0) {
+					end = size;
+					break;
+				}
+				auto nl = static_cast<const char*>(memchr(file.Data(), '\n', file.Length()));
+				if (nl != nullptr) {
+					end = from + (nl - file.Data()) + 1;
+					break;
+				}
+				if (from + (int64_t)file.Length() >= size)
+					end = size;
+			}
+			block.offsets.push_back(pos);
+			blocks.push_back(block);
+			pos = end;
+		}
+		file.Close();
+
+		// the blocks are scanned in parallel, each worker maps the block it's scanning
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			MappedFile view;
+			if (!view.Open(path_))
+				return;
+			for (size_t i = next++; i < blocks.size() && !stop_; i = next++) {
+				auto& block = blocks[i];
+				int64_t end = i + 1 < blocks.size() ? blocks[i + 1].begin : std::min(size, view.Size());
+				if (view.Map(block.begin, (size_t)(end - block.begin)))
+					Scan(view.Data(), view.Length(), block.begin, block);
+			}
+		};
+		unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::thread> pool;
+		for (unsigned i = 1; i < std::min<size_t>(threads, blocks.size()); i++)
+			pool.emplace_back(worker);
+		worker();
+		for (auto& thread : pool)
+			thread.join();
+	}
+	if (stop_)
+		return;
+
+	uint64_t lines = 0;
+	for (auto& block : blocks) {
+		block.first = lines;
+		lines += block.count;
+	}
+	int64_t indexedTo = blocks.empty() ? 0 : blocks.back().end;
+	DLog("Indexed %llu lines in %s\n", (unsigned long long)lines, path_.string().c_str());
+
+	std::lock_guard<std::mutex> guard(lock_);
+	blocks_ = std::move(blocks);
+	lines_ = lines;
+	indexedTo_ = indexedTo;
+	ready_ = true;
+}
+
+void LineIndex::Extend()
+{
+	LARGE_INTEGER size;
+	if (!Ready() || file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size))
+		return;
+
+	int64_t pos;
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		pos = indexedTo_;
+	}
+	if (size.QuadPart < pos) {
+		Start();
+		return;
+	}
+
+	std::vector<char> buf;
+	while (pos < size.QuadPart) {
+		buf.resize(ReadSize);
+		DWORD read = ReadAt(pos, buf.data(), (DWORD)std::min<int64_t>(ReadSize, size.QuadPart - pos));
+		if (read == 0)
+			break;
+
+		std::lock_guard<std::mutex> guard(lock_);
+		if (blocks_.empty()) {
+			Block block;
+			block.begin = block.end = pos;
+			block.offsets.push_back(pos);
+			blocks_.push_back(block);
+		}
+		auto& block = blocks_.back();
+		uint64_t count = block.count;
+		Scan(buf.data(), read, pos, block);
+		lines_ += block.count - count;
+		indexedTo_ = block.end;
+		pos += read;
+	}
+}
+
+bool LineIndex::Find(uint64_t line, int64_t& offset, uint64_t& skip) const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	if (line >= lines_)
+		return false;
+	auto block = std::upper_bound(blocks_.begin(), blocks_.end(), line,
+		[](uint64_t line, const Block& block) { return line < block.first; }) - 1;
+	uint64_t local = line - block->first;
+	offset = block->offsets[(size_t)(local / Stride)];
+	skip = local % Stride;
+	return true;
+}
+
+DWORD LineIndex::ReadAt(int64_t offset, char* buf, DWORD len) const
+{
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	DWORD read = 0;
+	if (!ReadFile(file_, buf, len, &read, &overlapped))
+		return 0;
+	return read;
+}
+
+bool LineIndex::ReadLine(uint64_t line, std::string& text) const
+{
+	int64_t pos;
+	uint64_t skip;
+	if (file_ == INVALID_HANDLE_VALUE || !Find(line, pos, skip))
+		return false;
+
+	// read forward from the indexed line, skipping the lines before the one we want
+	text.clear();
+	char buf[LineReadSize];
+	for (;;) {
+		DWORD read = ReadAt(pos, buf, sizeof(buf));
+		if (read == 0)
+			return false;	// truncated since it was indexed
+		const char* p = buf;
+		const char* end = buf + read;
+		for (; skip > 0 && p < end; skip--) {
+			auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (nl == nullptr) {
+				p = end;
+				break;
+			}
+			p = nl + 1;
+		}
+		if (skip == 0) {
+			auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+			text.append(p, nl != nullptr ? nl : end);
+			if (nl != nullptr || text.size() >= MaxLineLength)
+				break;
+		}
+		pos += read;
+	}
+	if (!text.empty() && text.back() == '\r')
+		text.pop_back();
+	return true;
+}
+
+LogEntryPtr LineIndex::GetParsed(uint64_t line) const
+{
+	std::lock_guard<std::mutex> guard(parsedLock_);
+	auto it = parsedLines_.find(line);
+	if (it == parsedLines_.end())
+		return nullptr;
+	parsed_.splice(parsed_.begin(), parsed_, it->second);
+	return it->second->second;
+}
+
+void LineIndex::AddParsed(uint64_t line, LogEntryPtr entry) const
+{
+	std::lock_guard<std::mutex> guard(parsedLock_);
+	if (parsedLines_.count(line) != 0)
+		return;
+	parsed_.emplace_front(line, std::move(entry));
+	parsedLines_[line] = parsed_.begin();
+	if (parsed_.size() > MaxParsed) {
+		parsedLines_.erase(parsed_.back().first);
+		parsed_.pop_back();
+	}
+}
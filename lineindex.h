@@ -0,0 +1,87 @@
+#pragma once
+
+#include "utils.h"
+#include "logentry.h"
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Where the lines of a file start, so a file of any size can be scrolled through
+// without its lines being held in memory. Only the start of every Stride'th line
+// is kept, the ones in between are found by reading forward from the nearest one.
+// The file is indexed on a background thread when it's opened, and the tailer
+// extends the index as the file grows. The lines that were parsed to be shown are
+// kept in a small LRU so scrolling back and forth doesn't read them again.
+class LineIndex
+{
+public:
+	static const int Stride = 16;
+
+	explicit LineIndex(const fs::path& path);
+	~LineIndex();
+
+	LineIndex(const LineIndex&) = delete;
+	LineIndex& operator=(const LineIndex&) = delete;
+
+	const fs::path& Path() const { return path_; }
+	// the day and time of day the file was last written when it was opened
+	int Day() const { return day_; }
+	int FileTime() const { return fileTime_; }
+
+	// (re)indexes the whole file in the background, there are no lines until it's done
+	void Start();
+	bool Ready() const { return ready_.load(std::memory_order_acquire); }
+	uint64_t NumLines() const;
+
+	// tailer only, indexes the complete lines written since the last call, starts
+	// again if the file has been truncated
+	void Extend();
+
+	// the text of a line without its line ending, false if it isn't indexed
+	bool ReadLine(uint64_t line, std::string& text) const;
+
+	// lines that have been parsed, the index doesn't parse them itself
+	LogEntryPtr GetParsed(uint64_t line) const;
+	void AddParsed(uint64_t line, LogEntryPtr entry) const;
+
+private:
+	// the lines that start in [begin, end), offsets[i] is where line first + i * Stride
+	// starts, the last one can be the start of a line that isn't complete yet
+	struct Block
+	{
+		uint64_t first = 0;
+		uint64_t count = 0;
+		int64_t begin = 0;
+		int64_t end = 0;
+		std::vector<int64_t> offsets;
+	};
+
+	fs::path path_;
+	HANDLE file_ = INVALID_HANDLE_VALUE;	// read at an offset, so the UI and the tailer can share it
+	int day_ = 0;
+	int fileTime_ = -1;
+
+	mutable std::mutex lock_;
+	std::vector<Block> blocks_;
+	uint64_t lines_ = 0;
+	int64_t indexedTo_ = 0;		// the end of the last complete line
+
+	std::thread builder_;
+	std::atomic<bool> ready_;
+	std::atomic<bool> stop_;
+
+	typedef std::list<std::pair<uint64_t, LogEntryPtr>> ParsedList;
+	mutable std::mutex parsedLock_;
+	mutable ParsedList parsed_;		// most recently used first
+	mutable std::unordered_map<uint64_t, ParsedList::iterator> parsedLines_;
+
+	void Build();
+	bool Find(uint64_t line, int64_t& offset, uint64_t& skip) const;
+	DWORD ReadAt(int64_t offset, char* buf, DWORD len) const;
+	static void Scan(const char* data, size_t len, int64_t base, Block& block);
+};
+
+typedef std::shared_ptr<LineIndex> LineIndexPtr;
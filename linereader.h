@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Reads a file in large blocks and splits it into lines. Any unterminated line
+// left at the end of a read is kept and completed by the next read, so a line
+// that is still being written is never split into two entries.
+class LineReader
+{
+	std::vector<char> buf_;
+	std::string partial_;		// unterminated line carried over from the last read
+	bool skipFirst_ = false;	// discard everything up to the first newline
+
+public:
+	explicit LineReader(size_t blockSize = 64 * 1024) : buf_(blockSize) {}
+
+	// forget any partial line, used when switching to a different file
+	void Reset() { partial_.clear(); skipFirst_ = false; }
+
+	// we've seeked into the middle of a file, drop the first (partial) line
+	void SkipToNextLine() { partial_.clear(); skipFirst_ = true; }
+
+	bool HasPartial() const { return !partial_.empty(); }
+
+	// emits the unterminated line, if any, when we're done with a file
+	template <typename Fn>
+	void Flush(Fn&& fn)
+	{
+		if (!partial_.empty())
+			Emit(partial_.data(), partial_.size(), fn);
+		partial_.clear();
+	}
+
+	// Reads one block from fp and calls fn(const char* line, size_t len) for every
+	// complete line, without the line terminator. Returns the number of bytes read,
+	// 0 at end of file. On a read error the partial line is flushed as a line.
+	template <typename Fn>
+	size_t Read(FILE* fp, Fn&& fn)
+	{
+		size_t n = fread(buf_.data(), 1, buf_.size(), fp);
+		if (n == 0) {
+			if (ferror(fp)) {
+				if (!partial_.empty()) {
+					Emit(partial_.data(), partial_.size(), fn);
+					partial_.clear();
+				}
+			}
+			clearerr(fp);
+			return 0;
+		}
+		Split(buf_.data(), n, fn);
+		return n;
+	}
+
+	// Splits a block of data into lines, carrying over any partial line.
+	// memchr is vectorised in both the MSVC and glibc runtimes, so finding the
+	// newline is the only scan over the data.
+	template <typename Fn>
+	void Split(const char* data, size_t n, Fn&& fn)
+	{
+		const char* p = data;
+		const char* end = data + n;
+		while (p < end) {
+			auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (nl == nullptr) {
+				if (!skipFirst_)
+					partial_.append(p, end);
+				return;
+			}
+			if (skipFirst_) {
+				skipFirst_ = false;
+			}
+			else if (!partial_.empty()) {
+				partial_.append(p, nl);
+				Emit(partial_.data(), partial_.size(), fn);
+				partial_.clear();
+			}
+			else
+				Emit(p, nl - p, fn);
+			p = nl + 1;
+		}
+	}
+
+private:
+	template <typename Fn>
+	static void Emit(const char* line, size_t len, Fn& fn)
+	{
+		if (len > 0 && line[len - 1] == '\r')
+			len--;
+		fn(line, len);
+	}
+};
@@ -0,0 +1,147 @@
+#include "logdirectory.h"
+#include <algorithm>
+
+// without change notifications the directory is scanned every couple of seconds,
+// with them a scan is only a safety net in case a notification was missed
+static const int ScanInterval = 2;
+static const int WatchedScanInterval = 30;
+
+std::shared_ptr<LogDirectory> LogDirectory::Get(const fs::path& dir)
+{
+	static std::mutex lock;
+	static std::map<std::string, std::weak_ptr<LogDirectory>> directories;
+
+	auto key = dir.string();
+	std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+	std::lock_guard<std::mutex> guard(lock);
+	auto ptr = directories[key].lock();
+	if (!ptr) {
+		ptr = std::make_shared<LogDirectory>(dir);
+		directories[key] = ptr;
+	}
+	return ptr;
+}
+
+void LogDirectory::AddPrefix(const std::string& prefix)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	for (const auto& latest : latest_) {
+		if (_stricmp(latest.prefix.c_str(), prefix.c_str()) == 0)
+			return;
+	}
+	Latest latest;
+	latest.prefix = prefix;
+	latest_.push_back(latest);
+	lastScan_ = 0;	// make sure the new prefix is picked up on the next lookup
+}
+
+bool LogDirectory::GetLatest(const std::string& prefix, fs::path& latest)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	if (lastScan_ + (watched_ ? WatchedScanInterval : ScanInterval) <= time(nullptr))
+		Rescan();
+
+	latest.clear();
+	if (!exists_)
+		return false;
+	for (const auto& entry : latest_) {
+		if (_stricmp(entry.prefix.c_str(), prefix.c_str()) == 0) {
+			latest = entry.path;
+			break;
+		}
+	}
+	return true;
+}
+
+std::vector<fs::path> LogDirectory::GetFiles(const std::string& prefix) const
+{
+	std::vector<std::pair<std::time_t, fs::path>> found;
+	for (auto p : fs::directory_iterator(dir_)) {
+		if (!fs::is_regular_file(p))
+			continue;
+		if (_strnicmp(p.path().filename().string().c_str(), prefix.c_str(), prefix.size()) != 0)
+			continue;
+		found.emplace_back(fs::last_write_time(p), p.path());
+	}
+	std::sort(found.begin(), found.end());
+
+	std::vector<fs::path> files;
+	for (const auto& file : found)
+		files.push_back(file.second);
+	return files;
+}
+
+void LogDirectory::OnChanged(const std::vector<std::string>& names, bool complete)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	if (!complete) {
+		lastScan_ = 0;
+		return;
+	}
+	for (const auto& name : names)
+		Update(dir_ / name);
+}
+
+void LogDirectory::SetWatched(bool watched)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	watched_ = watched;
+}
+
+LogDirectory::Latest* LogDirectory::Find(const std::string& filename)
+{
+	for (auto& latest : latest_) {
+		if (_strnicmp(filename.c_str(), latest.prefix.c_str(), latest.prefix.size()) == 0)
+			return &latest;
+	}
+	return nullptr;
+}
+
+void LogDirectory::Update(const fs::path& path)
+{
+	auto latest = Find(path.filename().string());
+	if (latest == nullptr)
+		return;
+
+	boost::system::error_code ec;
+	if (!fs::is_regular_file(path, ec))
+		return;
+	auto writeTime = fs::last_write_time(path, ec);
+	if (ec)
+		return;
+	if (latest->path.empty() || writeTime > latest->writeTime || path == latest->path) {
+		latest->path = path;
+		latest->writeTime = writeTime;
+	}
+}
+
+void LogDirectory::Rescan()
+{
+	// a single pass over the directory updates every prefix
+	lastScan_ = time(nullptr);
+	exists_ = fs::exists(dir_) && fs::is_directory(dir_);
+	if (!exists_)
+		return;
+
+	auto scanned = latest_;
+	for (auto& latest : scanned) {
+		latest.path.clear();
+		latest.writeTime = 0;
+	}
+
+	for (auto p : fs::directory_iterator(dir_)) {
+		auto filename = p.path().filename().string();
+		auto latest = std::find_if(scanned.begin(), scanned.end(), [&](const Latest& latest) {
+			return _strnicmp(filename.c_str(), latest.prefix.c_str(), latest.prefix.size()) == 0;
+		});
+		if (latest == scanned.end() || !fs::is_regular_file(p))
+			continue;
+		auto writeTime = fs::last_write_time(p);
+		if (latest->path.empty() || writeTime > latest->writeTime) {
+			latest->path = p.path();
+			latest->writeTime = writeTime;
+		}
+	}
+	latest_ = std::move(scanned);
+}
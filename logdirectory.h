@@ -0,0 +1,57 @@
+#pragma once
+
+#include "utils.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Keeps track of the latest log file for each name prefix in a directory. One
+// instance is shared by every LogFile in the same directory so the directory is
+// scanned once for all of them, and between scans it's kept up to date from the
+// change notifications the tailer receives.
+class LogDirectory
+{
+	struct Latest
+	{
+		std::string prefix;
+		fs::path path;
+		std::time_t writeTime = 0;
+	};
+
+	fs::path dir_;
+	mutable std::mutex lock_;
+	std::vector<Latest> latest_;	// one per prefix, there's only a handful
+	std::time_t lastScan_ = 0;
+	bool exists_ = false;
+	bool watched_ = false;
+
+public:
+	explicit LogDirectory(const fs::path& dir) : dir_(dir) {}
+
+	// returns the shared index for a directory, creating it if needed
+	static std::shared_ptr<LogDirectory> Get(const fs::path& dir);
+
+	const fs::path& Directory() const { return dir_; }
+	void AddPrefix(const std::string& prefix);
+
+	// Gets the latest file for a prefix, rescanning the directory if it's due.
+	// Returns false if the directory doesn't exist, latest is empty if there's
+	// no file for the prefix yet.
+	bool GetLatest(const std::string& prefix, fs::path& latest);
+
+	// all files for a prefix, oldest first, so we can read back through rotated logs
+	std::vector<fs::path> GetFiles(const std::string& prefix) const;
+
+	// change notifications from the tailer, complete is false if some were lost
+	void OnChanged(const std::vector<std::string>& names, bool complete);
+	void SetWatched(bool watched);
+
+private:
+	void Rescan();
+	void Update(const fs::path& path);
+	Latest* Find(const std::string& filename);
+};
+
+typedef std::shared_ptr<LogDirectory> LogDirectoryPtr;
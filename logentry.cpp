@@ -0,0 +1,120 @@
+#include "logentry.h"
+
+LogEntryView LogEntryView::Of(const LogEntry& entry)
+{
+	LogEntryView view;
+	view.type = entry.type;
+	view.timestamp = entry.timestamp;
+	view.time = entry.time;
+	view.day = entry.day;
+	view.tid = entry.tid;
+	view.duration = entry.duration;
+	view.body = LogText(entry.body.c_str(), entry.body.size());
+	view.severity = LogText(entry.severity.c_str(), entry.severity.size());
+	view.id = LogText(entry.id.c_str(), entry.id.size());
+	return view;
+}
+
+void LogEntryView::CopyTo(LogEntry& entry) const
+{
+	entry.type = type;
+	entry.timestamp = timestamp;
+	entry.time = time;
+	entry.day = day;
+	entry.tid = tid;
+	entry.duration = duration;
+	entry.body.assign(body.data(), body.size());
+	entry.severity.assign(severity.data(), severity.size());
+	entry.id.assign(id.data(), id.size());
+}
+
+LogChunk::LogChunk(uint64_t first, uint32_t maxLines, uint32_t maxBytes)
+	: lines_(new Line[maxLines]), bytes_(new char[maxBytes]), first_(first), maxLines_(maxLines), maxBytes_(maxBytes), count_(0)
+{
+}
+
+uint32_t LogChunk::BytesNeeded(const LogEntry& entry)
+{
+	// empty strings aren't stored, each of the others has a nul after it
+	auto needed = [](const std::string& text) { return text.empty() ? 0 : (uint32_t)text.size() + 1; };
+	return needed(entry.body) + needed(entry.severity) + needed(entry.id);
+}
+
+uint32_t LogChunk::Store(const std::string& text)
+{
+	if (text.empty())
+		return 0;
+	uint32_t offset = usedBytes_;
+	memcpy(&bytes_[offset], text.data(), text.size());
+	bytes_[offset + text.size()] = '\0';
+	usedBytes_ += (uint32_t)text.size() + 1;
+	return offset;
+}
+
+bool LogChunk::Append(const LogEntry& entry)
+{
+	uint32_t count = count_.load(std::memory_order_relaxed);
+	if (count == maxLines_ || BytesNeeded(entry) > maxBytes_ - usedBytes_)
+		return false;
+
+	auto& line = lines_[count];
+	line.type = entry.type;
+	line.time = entry.time;
+	line.day = entry.day;
+	line.tid = entry.tid;
+	line.duration = entry.duration;
+	line.timestamp = entry.timestamp;
+	line.body = Store(entry.body);
+	line.bodyLen = (uint32_t)entry.body.size();
+	line.severity = Store(entry.severity);
+	line.severityLen = (uint32_t)entry.severity.size();
+	line.id = Store(entry.id);
+	line.idLen = (uint32_t)entry.id.size();
+
+	// readers can see the line once the count includes it
+	count_.store(count + 1, std::memory_order_release);
+	return true;
+}
+
+LogEntryView LogChunk::MakeView(const Line& line, const char* bytes)
+{
+	auto text = [bytes](uint32_t offset, uint32_t len) { return len == 0 ? LogText() : LogText(bytes + offset, len); };
+
+	LogEntryView view;
+	view.type = line.type;
+	view.timestamp = line.timestamp;
+	view.time = line.time;
+	view.day = line.day;
+	view.tid = line.tid;
+	view.duration = line.duration;
+	view.body = text(line.body, line.bodyLen);
+	view.severity = text(line.severity, line.severityLen);
+	view.id = text(line.id, line.idLen);
+	return view;
+}
+
+LogEntryView LogChunk::Get(size_t idx) const
+{
+	return MakeView(lines_[idx], bytes_.get());
+}
+
+size_t LogChunk::SerializedSize() const
+{
+	return 2 * sizeof(uint32_t) + Count() * sizeof(Line) + usedBytes_;
+}
+
+void LogChunk::Serialize(char* out) const
+{
+	uint32_t count = (uint32_t)Count();
+	reinterpret_cast<uint32_t*>(out)[0] = count;
+	reinterpret_cast<uint32_t*>(out)[1] = usedBytes_;
+	out += 2 * sizeof(uint32_t);
+	memcpy(out, lines_.get(), count * sizeof(Line));
+	memcpy(out + count * sizeof(Line), bytes_.get(), usedBytes_);
+}
+
+LogEntryView LogChunk::Get(const char* block, size_t idx)
+{
+	auto lines = reinterpret_cast<const Line*>(block + 2 * sizeof(uint32_t));
+	return MakeView(lines[idx], reinterpret_cast<const char*>(lines + Count(block)));
+}
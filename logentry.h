@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+
+enum class MessageType { normal, continuation, cfgSvc, system, separator };
+
+struct LogEntry
+{
+	MessageType type = MessageType::normal;
+	time_t timestamp = 0;
+	int time = -1;		// milliseconds since midnight, -1 if the line has no time
+	int day = 0;		// days since 1970-01-01
+	std::string body;
+	int tid = 0;
+	int duration = 0;	// milliseconds since the previous entry with a time
+
+	// for config service
+	std::string severity;
+	std::string id;
+
+	// back to a blank entry, the strings keep their capacity so an entry can be reused
+	void Clear()
+	{
+		type = MessageType::normal;
+		timestamp = 0;
+		time = -1;
+		day = 0;
+		tid = 0;
+		duration = 0;
+		body.clear();
+		severity.clear();
+		id.clear();
+	}
+};
+
+typedef std::shared_ptr<LogEntry> LogEntryPtr;
+
+// a run of entries handed to the subscribers together, only valid during the callback
+class LogEntrySpan
+{
+	const LogEntry* entries_;
+	size_t count_;
+
+public:
+	LogEntrySpan(const LogEntry* entries, size_t count) : entries_(entries), count_(count) {}
+
+	const LogEntry* begin() const { return entries_; }
+	const LogEntry* end() const { return entries_ + count_; }
+	size_t size() const { return count_; }
+	bool empty() const { return count_ == 0; }
+	const LogEntry& operator[](size_t idx) const { return entries_[idx]; }
+};
+
+// text kept in a LogChunk, it's nul terminated so it can be printed as is
+class LogText
+{
+	const char* text_ = "";
+	size_t len_ = 0;
+
+public:
+	LogText() {}
+	LogText(const char* text, size_t len) : text_(text), len_(len) {}
+
+	const char* c_str() const { return text_; }
+	const char* data() const { return text_; }
+	size_t size() const { return len_; }
+	bool empty() const { return len_ == 0; }
+	const char* begin() const { return text_; }
+	const char* end() const { return text_ + len_; }
+	std::string str() const { return std::string(text_, len_); }
+
+	bool operator==(const std::string& rhs) const { return rhs.size() == len_ && memcmp(rhs.data(), text_, len_) == 0; }
+	bool operator!=(const std::string& rhs) const { return !(*this == rhs); }
+};
+
+inline bool operator==(const std::string& lhs, const LogText& rhs) { return rhs == lhs; }
+inline bool operator!=(const std::string& lhs, const LogText& rhs) { return rhs != lhs; }
+
+// a line in a LogChunk, the text is only valid as long as the chunk is
+struct LogEntryView
+{
+	MessageType type = MessageType::normal;
+	time_t timestamp = 0;
+	int time = -1;
+	int day = 0;
+	int tid = 0;
+	int duration = 0;
+	LogText body;
+	LogText severity;
+	LogText id;
+
+	// a view of an entry that's kept somewhere else
+	static LogEntryView Of(const LogEntry& entry);
+
+	// for anything that needs to keep the line after the chunk has gone
+	void CopyTo(LogEntry& entry) const;
+	LogEntry Copy() const
+	{
+		LogEntry entry;
+		CopyTo(entry);
+		return entry;
+	}
+};
+
+// A block of lines stored together, the fixed size part of every line in one
+// array and all their text in another. A few thousand lines take a handful of
+// allocations and they're freed together when the chunk drops out of the buffer.
+// One thread appends, any number can read the lines that were complete when
+// they called Count(). When a chunk drops out of the buffer it's written out
+// as a single block that can be read in place with the static Get.
+class LogChunk
+{
+	struct Line
+	{
+		MessageType type;
+		int time;
+		int day;
+		int tid;
+		int duration;
+		time_t timestamp;
+		uint32_t body;		// offsets of the text in bytes_
+		uint32_t bodyLen;
+		uint32_t severity;
+		uint32_t severityLen;
+		uint32_t id;
+		uint32_t idLen;
+	};
+
+	std::unique_ptr<Line[]> lines_;
+	std::unique_ptr<char[]> bytes_;
+	uint64_t first_;		// line number of the first line
+	uint32_t maxLines_;
+	uint32_t maxBytes_;
+	uint32_t usedBytes_ = 0;
+	std::atomic<uint32_t> count_;
+
+public:
+	static const uint32_t DefaultLines = 256;
+	static const uint32_t DefaultBytes = 64 * 1024;
+
+	LogChunk(uint64_t first = 0, uint32_t maxLines = DefaultLines, uint32_t maxBytes = DefaultBytes);
+
+	LogChunk(const LogChunk&) = delete;
+	LogChunk& operator=(const LogChunk&) = delete;
+
+	// text space an entry needs, a chunk has to have at least this many bytes to take it
+	static uint32_t BytesNeeded(const LogEntry& entry);
+
+	// returns false if the chunk is full
+	bool Append(const LogEntry& entry);
+
+	uint64_t First() const { return first_; }
+	size_t Count() const { return count_.load(std::memory_order_acquire); }
+	uint32_t UsedBytes() const { return usedBytes_; }	// writer only
+	LogEntryView Get(size_t idx) const;
+
+	// memory held by the chunk, whether or not it's full
+	size_t Footprint() const { return sizeof(*this) + maxLines_ * sizeof(Line) + maxBytes_; }
+
+	// the lines as one block, a count and text size followed by the lines then the text,
+	// out has to be 8 byte aligned and the block can be read without copying it back
+	size_t SerializedSize() const;
+	void Serialize(char* out) const;
+	static uint32_t Count(const char* block) { return reinterpret_cast<const uint32_t*>(block)[0]; }
+	static LogEntryView Get(const char* block, size_t idx);
+
+private:
+	static LogEntryView MakeView(const Line& line, const char* bytes);
+	uint32_t Store(const std::string& text);
+};
+
+typedef std::shared_ptr<LogChunk> LogChunkPtr;
@@ -1,16 +1,36 @@
 #pragma once
 #include "logfile.h"
+#include "controllerline.h"
+#include "mappedfile.h"
 
 #include <boost/regex.hpp>
 #include <boost/circular_buffer.hpp>
+#include <cassert>
+#include <chrono>
+#include <io.h>
+#include <fcntl.h>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
 
-LogFile::LogFile(fs::path logDir, std::string namePrefix, bool cfgSvc, int bufSize) 
-	: fp_(nullptr), buffer_(bufSize), exiting_(false)
+// enough chunk slots for a big budget, each one is only a couple of pointers
+static const size_t MaxChunks = 4096;
+// chunks of short lines are given less text space than the default
+static const uint32_t MinChunkBytes = 4 * 1024;
+// most entries held back from the subscribers at once
+static const size_t MaxPending = 4096;
+
+LogFile::LogFile(fs::path logDir, std::string namePrefix, bool cfgSvc) 
+	: fp_(nullptr), buffer_(MaxChunks), numLines_(0), bufferBytes_(0), budget_(8 * 1024 * 1024), bytesAppended_(0), exiting_(false)
+	, spill_(new SpillStore(namePrefix))
 	, logDir_(logDir), namePrefix_(namePrefix), cfgSvc_(cfgSvc)
 {
 	pattern_ = cfgSvc
 		? boost::regex("^(\\d{4}-\\d{2}-\\d{2})\\s(\\d{2}:\\d{2}:\\d{2}\\.\\d{3}).*?\\[(.*?)\\]\\s\\[(.*?)\\]\\s(.*)")
 		: boost::regex("^(\\d+)\\s(\\d{2}:\\d{2}:\\d{2}\\.\\d{3})\\s(.*)$");
+	directory_ = LogDirectory::Get(logDir);
+	directory_->AddPrefix(namePrefix);
 }
 
 LogFile::~LogFile()
@@ -18,23 +38,77 @@ LogFile::~LogFile()
 	Close();
 }
 
-bool LogFile::Open(const char* filename)
+static bool GetFileId(HANDLE handle, FileId& id)
+{
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle(handle, &info))
+		return false;
+	id.volume = info.dwVolumeSerialNumber;
+	id.index = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	return true;
+}
+
+static bool GetFileId(const fs::path& path, FileId& id)
+{
+	HANDLE handle = CreateFile(path.string().c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	bool res = GetFileId(handle, id);
+	CloseHandle(handle);
+	return res;
+}
+
+static FILE* OpenShared(const char* filename, FileId* id = nullptr)
+{
+	// share delete as well, otherwise we'd stop the log from being renamed when it's rotated
+	HANDLE handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return nullptr;
+	if (id)
+		GetFileId(handle, *id);
+	int fd = _open_osfhandle((intptr_t)handle, _O_RDONLY | _O_BINARY);
+	if (fd == -1) {
+		CloseHandle(handle);
+		return nullptr;
+	}
+	FILE* fp = _fdopen(fd, "rb");
+	if (fp == nullptr) {
+		_close(fd);
+		return nullptr;
+	}
+	// LineReader does its own buffering in large blocks
+	setvbuf(fp, nullptr, _IONBF, 0);
+	return fp;
+}
+
+bool LogFile::Open(const char* filename, bool fromStart)
 {
 	Close();
-	fp_ = _fsopen(filename, "rt", _SH_DENYNO);
+	fp_ = OpenShared(filename, &fileId_);
 	if (fp_ == nullptr)
 		return false;
+	reader_.Reset();
+	lastRotationCheck_ = time(nullptr);
+
+	struct _stat64 st;
+	_fstat64(_fileno(fp_), &st);
+	if (fromStart && lastStamp_ >= 0) {
+		// carry on from the previous file, the day follows on from its last line
+		return true;
+	}
+
+	LocalDayAndTime(st.st_mtime, day_, fileTime_);
+	lastStamp_ = -1;
 
 	const int Threshold = 20 * 8192;
-	struct stat st;
-	fstat(_fileno(fp_), &st);
-	if (st.st_size > Threshold) {
-		auto bytes = std::min((int)st.st_size, Threshold);
-		fseek(fp_, -bytes, SEEK_END);
+	if (!fromStart && st.st_size > Threshold) {
+		_fseeki64(fp_, -Threshold, SEEK_END);
+		stats_.bytesSkipped += st.st_size - Threshold;
 
 		// forward to the next line
-		for (int c = fgetc(fp_); c != EOF && c != '\n' && !ferror(fp_);)
-			c = fgetc(fp_);
+		reader_.SkipToNextLine();
 	}
 
 	return true;
@@ -46,139 +120,706 @@ void LogFile::Close()
 		fclose(fp_), fp_ = nullptr;
 }
 
-void LogFile::CheckForLogFile()
+void LogFile::AddSystemEntry(const std::string& text)
 {
-	// only check once every 2 seconds
-	if (lastLogCheck_ + 2 > time(nullptr))
-		return;
+	LogEntry entry;
+	entry.timestamp = time(nullptr);
+	entry.type = MessageType::system;
+	entry.body = text;
+	DLog("%s\n", entry.body.c_str());
+	AddLogEntry(entry);
+	FlushEntries();
+}
+
+void LogFile::AddLogEntry(const LogEntry& entry)
+{
+	if (!current_ || !current_->Append(entry)) {
+		// size the next chunk's text from how much the last one used, so a log of short lines
+		// doesn't hold on to mostly empty chunks, and a line too big for that gets a chunk to fit
+		uint32_t bytes = LogChunk::DefaultBytes;
+		if (current_)
+			bytes = std::min(bytes, std::max(MinChunkBytes, current_->UsedBytes() + current_->UsedBytes() / 4));
+		current_ = std::make_shared<LogChunk>(lines_, LogChunk::DefaultLines, std::max(bytes, LogChunk::BytesNeeded(entry)));
+		current_->Append(entry);
+
+		// make room rather than let the push overwrite the oldest chunk before it's spilled
+		if (chunkInfo_.size() == buffer_.Capacity())
+			DropOldestChunk();
+		ChunkInfo info;
+		info.chunk = current_;
+		info.bytes = current_->Footprint();
+		chunkInfo_.push_back(info);
+		buffer_.Push(current_, info.bytes);
+		bufferBytes_ = buffer_.Weight();
 
-	if (!fs::exists(logDir_) || !fs::is_directory(logDir_)) {
-		if (buffer_.size() == 0) {
-			auto entry = std::make_shared<LogEntry>();
-			entry->timestamp = time(nullptr);
-			entry->type = MessageType::system;
-			entry->body = "Directory does not exist or is not a directory: " + logDir_.string();
-			DLog("%s\n", entry->body.c_str());
-			AddLogEntry(entry);
+		// chunks a snapshot still holds count too, but dropping more won't free them
+		// any sooner, so stop at the first one that has to wait
+		while (chunkInfo_.size() > 2 && bufferBytes_ > budget_) {
+			DropOldestChunk();
+			if (buffer_.RetiredWeight() > 0)
+				break;
 		}
+	}
+	if (entry.time >= 0 && entry.type != MessageType::system)
+		times_.Add(lines_, MakeStamp(entry.day, entry.time));
+	lines_++;
+	bytesAppended_ += LogChunk::BytesNeeded(entry);
+
+	if (subscribed_) {
+		if (numPending_ == pending_.size())
+			pending_.emplace_back();
+		pending_[numPending_++] = entry;
+		if (numPending_ == MaxPending)
+			FlushEntries();
+	}
+}
+
+void LogFile::FlushEntries()
+{
+	numLines_.store((int)(lines_ - firstLine_), std::memory_order_release);
+	if (numPending_ == 0)
 		return;
+	subscribers_(shared_from_this(), LogEntrySpan(pending_.data(), numPending_));
+	numPending_ = 0;
+}
+
+boost::signals2::connection LogFile::Subscribe(const LogEntriesSignal::slot_type& slot)
+{
+	subscribed_ = true;
+	return subscribers_.connect(slot);
+}
+
+void LogFile::DropOldestChunk()
+{
+	// spill it before it's dropped, so a snapshot finds every line in one place or the other
+	spill_->Append(*chunkInfo_.front().chunk);
+	if (!stats_.spillFailed && spill_->Failed())
+		stats_.spillFailed = true;
+	buffer_.Drop();
+	bufferBytes_ = buffer_.Weight();
+	chunkInfo_.pop_front();
+	firstLine_ = spill_->EndLine() == chunkInfo_.front().chunk->First() ? spill_->FirstLine() : chunkInfo_.front().chunk->First();
+	times_.DropBefore(firstLine_);
+}
+
+LogSnapshot::LogSnapshot(const LogFile& logfile)
+	: file_(logfile), index_(logfile.GetIndex()), reader_(logfile.buffer_), spill_(*logfile.spill_)
+{
+	if (index_ && index_->Ready() && index_->NumLines() > 0) {
+		numLines_ = (int)std::min<uint64_t>(index_->NumLines(), std::numeric_limits<int>::max());
+		return;
+	}
+	index_.reset();
+
+	for (uint64_t seq = reader_.Tail(); seq < reader_.Head(); seq++) {
+		auto chunk = reader_.Get(seq);
+		if (chunk == nullptr)
+			continue;	// dropped since the reader was created
+		chunks_.push_back(chunk);
+	}
+	if (chunks_.empty())
+		return;
+
+	// chunks are spilled before they're dropped, so the lines on disk run up to (or
+	// past) the oldest one we have in memory unless spilling has failed
+	uint64_t memFirst = chunks_.front()->First();
+	uint64_t spillFirst = spill_.FirstLine();
+	uint64_t spillEnd = spill_.EndLine();
+	firstLine_ = memFirst;
+	if (spillEnd > spillFirst && spillFirst < memFirst && spillEnd >= memFirst) {
+		firstLine_ = spillFirst;
+		spilledLines_ = (int)(memFirst - spillFirst);
+	}
+
+	numLines_ = spilledLines_;
+	for (auto chunk : chunks_) {
+		starts_.push_back(numLines_);
+		numLines_ += (int)chunk->Count();
 	}
+}
 
+bool LogSnapshot::GetEntry(int idx, LogEntryView& entry) const
+{
+	if (idx < 0 || idx >= numLines_)
+		return false;
+	if (index_) {
+		auto parsed = file_.GetIndexedEntry(*index_, idx);
+		if (!parsed)
+			return false;
+		indexed_.push_back(parsed);
+		entry = LogEntryView::Of(*parsed);
+		return true;
+	}
+	if (idx < spilledLines_) {
+		uint64_t line = firstLine_ + idx;
+		if (!block_ || line < blockFirst_ || line >= blockFirst_ + LogChunk::Count(block_.get()))
+			block_ = spill_.Load(line, blockFirst_);
+		if (!block_)
+			return false;	// the segment it was in has gone
+		entry = LogChunk::Get(block_.get(), (size_t)(line - blockFirst_));
+		return true;
+	}
+	size_t i = std::upper_bound(starts_.begin(), starts_.end(), idx) - starts_.begin() - 1;
+	entry = chunks_[i]->Get(idx - starts_[i]);
+	return true;
+}
+
+// the stamp of the first line with a time at or after idx, -1 if there isn't one before end
+static int64_t StampAt(const LogSnapshot& snapshot, int& idx, int end)
+{
+	LogEntryView entry;
+	for (; idx < end; idx++) {
+		if (snapshot.GetEntry(idx, entry) && entry.time >= 0 && entry.type != MessageType::system)
+			return MakeStamp(entry.day, entry.time);
+	}
+	return -1;
+}
+
+int LogSnapshot::FindTime(int64_t stamp) const
+{
+	if (numLines_ == 0)
+		return -1;
+
+	int idx = 0;
+	if (index_)
+		idx = FindIndexedTime(stamp);
+	else {
+		uint64_t line = file_.times_.Find(stamp, firstLine_);
+		idx = (int)std::min<uint64_t>(line - firstLine_, numLines_);
+	}
+
+	// every line before idx is earlier, the one we want is within a checkpoint of it
+	for (int end = numLines_; idx < end; idx++) {
+		int64_t at = StampAt(*this, idx, end);
+		if (at < 0 || at >= stamp)
+			break;
+	}
+	return std::min(idx, numLines_ - 1);
+}
+
+int LogSnapshot::FindIndexedTime(int64_t stamp) const
+{
+	// there are no checkpoints for a file we've only indexed, so binary search the lines,
+	// each probe parses a line or two and the LRU keeps them for the scan that follows
+	int lo = 0;
+	int hi = numLines_;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		int at = mid;
+		int64_t found = StampAt(*this, at, hi);
+		if (found >= 0 && found < stamp)
+			lo = at + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int LogSnapshot::FindTimeOfDay(int time) const
+{
+	// go by the day of the last line with a time, if the time is later than that it's the day before
+	LogEntryView entry;
+	for (int idx = numLines_ - 1; idx >= 0 && idx >= numLines_ - (int)TimeIndex::EveryLines; idx--) {
+		if (!GetEntry(idx, entry) || entry.time < 0 || entry.type == MessageType::system)
+			continue;
+		int64_t last = MakeStamp(entry.day, entry.time);
+		int64_t stamp = MakeStamp(entry.day, time);
+		return FindTime(stamp > last ? stamp - MsPerDay : stamp);
+	}
+	return -1;
+}
+
+void LogFile::SwitchTo(const fs::path& filename)
+{
+	// this is the first file, only read the end of it, otherwise the previous one was
+	// rotated, so read it to the end and then read the new one from the beginning
+	bool rotated = !logFile_.empty();
+	if (fp_ != nullptr) {
+		ReadLines();
+		reader_.Flush([this](const char* line, size_t len) {
+			AddLine(line, len);
+			stats_.partialLines++;
+		});
+		FlushEntries();
+	}
+
+	if (!rotated && backfill_.Enabled() && Backfill(filename)) {
+		logFile_ = filename;
+		AddSystemEntry("Opened " + logFile_.string());
+	}
+	else if (Open(filename.string().c_str(), rotated)) {
+		logFile_ = filename;
+		if (rotated)
+			stats_.rotations++;
+		AddSystemEntry("Opened " + logFile_.string());
+	}
+	else {
+		lastOpenAttempt_ = time(nullptr);
+		if (buffer_.Size() == 0)
+			AddSystemEntry("Error loading log file for " + filename.string());
+		return;
+	}
+
+	if (indexed_) {
+		auto index = std::make_shared<LineIndex>(logFile_);
+		index->Start();
+		std::atomic_store(&index_, index);
+	}
+}
+
+bool LogFile::Backfill(const fs::path& current)
+{
+	// open the live file first, what we backfill from it is up to its size now
+	// and the tail picks up from wherever the backfill finishes
+	auto started = std::chrono::steady_clock::now();
+	if (!Open(current.string().c_str(), true))
+		return false;
+	struct _stat64 st;
+	_fstat64(_fileno(fp_), &st);
+
+	struct Range
+	{
+		fs::path path;
+		int64_t begin;
+		int64_t end;
+		time_t writeTime;
+	};
+
+	// work back from the current file until the budget is used up, files last
+	// written before the time window can't have anything we want
+	auto files = directory_->GetFiles(namePrefix_);
+	files.erase(std::remove(files.begin(), files.end(), current), files.end());
+	files.push_back(current);
+
+	time_t cutoff = backfill_.minutes > 0 ? time(nullptr) - backfill_.minutes * 60 : 0;
+	int64_t budget = backfill_.maxBytes > 0 ? backfill_.maxBytes : std::numeric_limits<int64_t>::max();
+	std::vector<Range> ranges;
 	try {
-		namespace fs = boost::filesystem;
-		// instead of basing this on the filename, we're going to find the latest modified log file
-		lastLogCheck_ = time(nullptr);
-		fs::directory_entry latest;
-		for (auto p : fs::directory_iterator(logDir_)) {
-			if (!fs::is_regular_file(p))
-				continue;
-			if (_strnicmp(p.path().filename().string().c_str(), namePrefix_.c_str(), namePrefix_.size()) != 0)
-				continue;
-
-			if (latest == fs::directory_entry() || fs::last_write_time(p) > fs::last_write_time(latest))
-				latest = p;
-		}
-		if (latest.path() == logFile_) {
-			return;	// no file found or we've aleady opened the latest
-		}
-		if (fs::exists(latest) && Open(latest.path().string().c_str())) {
-			logFile_ = latest;
-			auto entry = std::make_shared<LogEntry>();
-			entry->timestamp = time(nullptr);
-			entry->type = MessageType::system;
-			entry->body = "Opened " + logFile_.string();
-			DLog("%s\n", entry->body.c_str());
-			AddLogEntry(entry);
-		}
-		else if (buffer_.size() == 0) {
-			auto entry = std::make_shared<LogEntry>();
-			entry->timestamp = time(nullptr);
-			entry->type = MessageType::system;
-			entry->body = "Error loading log file for " + latest.path().string();
-			DLog("%s\n", entry->body.c_str());
-			AddLogEntry(entry);
+		for (auto it = files.rbegin(); it != files.rend() && budget > 0; ++it) {
+			Range range;
+			range.path = *it;
+			range.writeTime = fs::last_write_time(*it);
+			range.end = it == files.rbegin() ? st.st_size : (int64_t)fs::file_size(*it);
+			if (it != files.rbegin() && range.writeTime < cutoff)
+				break;
+			range.begin = std::max<int64_t>(0, range.end - budget);
+			budget -= range.end - range.begin;
+			ranges.insert(ranges.begin(), range);
 		}
 	}
 	catch (std::exception& e) {
-		if (buffer_.size() == 0) {
-			auto entry = std::make_shared<LogEntry>();
-			entry->timestamp = time(nullptr);
-			entry->type = MessageType::system;
-			entry->body = "Error loading log file for " + namePrefix_ + " - " + std::string(e.what());
-			DLog("%s\n", entry->body.c_str());
-			AddLogEntry(entry);
+		DLog("Error finding rotated logs for %s - %s\n", namePrefix_.c_str(), e.what());
+	}
+	if (ranges.empty() || ranges.back().path != current)
+		return false;
+
+	// split the files into chunks, the chunks are parsed on a pool of threads and
+	// merged back in order on this one as they complete
+	struct Chunk
+	{
+		size_t range;
+		int64_t begin;
+		int64_t end;
+		int64_t parsedTo;
+		std::vector<LogChunkPtr> lines;
+	};
+	const int64_t ChunkSize = 4 * 1024 * 1024;
+	std::vector<Chunk> chunks;
+	int64_t totalBytes = 0;
+	for (size_t r = 0; r < ranges.size(); r++) {
+		totalBytes += ranges[r].end - ranges[r].begin;
+		for (int64_t pos = ranges[r].begin; pos < ranges[r].end; pos += ChunkSize) {
+			Chunk chunk;
+			chunk.range = r;
+			chunk.begin = pos;
+			chunk.end = std::min(pos + ChunkSize, ranges[r].end);
+			chunk.parsedTo = -1;
+			chunks.push_back(std::move(chunk));
 		}
 	}
-}
 
-void LogFile::Tail()
-{	
-	if (paused_)
-		return;
-	CheckForLogFile();
-	if (fp_ == nullptr)
-		return;
+	std::mutex lock;
+	std::condition_variable cv;
+	size_t next = 0;
+	size_t merged = 0;
+	bool stop = false;
+	std::vector<char> done(chunks.size());
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t window = threads * 2;	// don't parse too far ahead of the merge, it bounds memory
+
+	auto worker = [&]() {
+		for (;;) {
+			size_t i;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				cv.wait(guard, [&]() { return stop || next >= chunks.size() || next < merged + window; });
+				if (stop || next >= chunks.size())
+					return;
+				i = next++;
+			}
+			auto& chunk = chunks[i];
+			const auto& range = ranges[chunk.range];
+			// the live file may have a line that's still being written at the end
+			bool complete = chunk.range + 1 < ranges.size();
+			chunk.parsedTo = ParseChunk(range.path, chunk.begin, chunk.end, range.end, complete, chunk.lines);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				done[i] = 1;
+			}
+			cv.notify_all();
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned i = 0; i < std::min<size_t>(threads, chunks.size()); i++)
+		pool.emplace_back(worker);
 
-	std::string line;
-	int lineNo = 0;
-	while (!exiting_) {
-		int c = fgetc(fp_);
-		if (c == EOF) {
-			if (ferror(fp_)) {
-				if (!line.empty()) {
-					AddLogEntry(ParseLine(line));
-					line.clear();
+	int nowDay, nowTime;
+	LocalDayAndTime(time(nullptr), nowDay, nowTime);
+	int64_t cutoffStamp = backfill_.minutes > 0 ? MakeStamp(nowDay, nowTime) - backfill_.minutes * 60 * 1000LL : -1;
+	int64_t liveOffset = ranges.back().begin;
+	bool keep = true;
+	uint64_t added = 0;
+	LogEntry entry;
+	for (size_t i = 0; i < chunks.size() && !exiting_; i++) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			cv.wait(guard, [&]() { return done[i] != 0; });
+		}
+
+		auto& chunk = chunks[i];
+		if (i == 0) {
+			// the first file sets the day, the following files carry on from it
+			LocalDayAndTime(ranges[0].writeTime, day_, fileTime_);
+			lastStamp_ = -1;
+		}
+		for (const auto& lines : chunk.lines) {
+			for (size_t j = 0; j < lines->Count(); j++) {
+				lines->Get(j).CopyTo(entry);
+				StampEntry(entry);
+				// continuation lines are kept or dropped along with the line they follow
+				if (entry.time >= 0)
+					keep = cutoffStamp < 0 || MakeStamp(entry.day, entry.time) >= cutoffStamp;
+				if (keep) {
+					AddLogEntry(entry);
+					added++;
 				}
-				break;
 			}
-			clearerr(fp_);
+		}
+		if (chunk.range + 1 == ranges.size())
+			liveOffset = std::max(liveOffset, chunk.parsedTo);
+		chunk.lines.clear();
+		FlushEntries();
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			merged = i + 1;
+		}
+		cv.notify_all();
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+	}
+	cv.notify_all();
+	for (auto& thread : pool)
+		thread.join();
+
+	// carry on tailing the live file from the end of the last complete line
+	_fseeki64(fp_, liveOffset, SEEK_SET);
+	reader_.Reset();
+	if (liveOffset == ranges.back().begin && liveOffset > 0)
+		reader_.SkipToNextLine();
+	stats_.linesRead += added;
+	stats_.bytesSkipped += ranges.front().begin;
+
+	// the time it took is shown so it can be checked against the target, a GB of
+	// Engine logs in a few seconds on 8 cores
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+	char buf[192];
+	snprintf(buf, sizeof(buf), "Backfilled %llu lines (%.1f MB) from %d files in %lld ms on %u threads",
+		(unsigned long long)added, totalBytes / (1024.0 * 1024.0), (int)ranges.size(), (long long)ms, threads);
+	DLog("%s: %s\n", namePrefix_.c_str(), buf);
+	AddSystemEntry(buf);
+	return true;
+}
+
+int64_t LogFile::ParseChunk(const fs::path& path, int64_t begin, int64_t end, int64_t limit, bool complete,
+	std::vector<LogChunkPtr>& lines) const
+{
+	MappedFile file;
+	if (!file.Open(path))
+		return -1;
+	limit = std::min(limit, file.Size());
+
+	// start a byte early to tell if begin is at the start of a line, and map a bit past
+	// the end for the last line that starts in the chunk, or up to the limit if it's longer
+	int64_t base = begin > 0 ? begin - 1 : 0;
+	if (base >= limit)
+		return -1;
+	const size_t Slack = 64 * 1024;
+	size_t want = (size_t)(end - base);
+	if (!file.Map(base, (size_t)std::min<int64_t>(want + Slack, limit - base)))
+		return -1;
+	if (file.Length() > want && base + (int64_t)file.Length() < limit
+		&& memchr(file.Data() + want - 1, '\n', file.Length() - want + 1) == nullptr) {
+		if (!file.Map(base, (size_t)(limit - base)))
+			return -1;
+	}
+
+	// lines are parsed straight from the mapping, they're only copied into the entries
+	const char* data = file.Data();
+	size_t size = file.Length();
+	const char* p = data;
+	const char* last = p + size;
+	const char* chunkEnd = p + std::min(want, size);
+	if (begin > 0) {
+		// the line that's in progress at begin belongs to the previous chunk
+		auto nl = static_cast<const char*>(memchr(p, '\n', size));
+		if (nl == nullptr)
+			return -1;
+		p = nl + 1;
+	}
+
+	int64_t parsedTo = -1;
+	LogEntry entry;
+	std::string scratch;
+	while (p < chunkEnd) {
+		auto nl = static_cast<const char*>(memchr(p, '\n', last - p));
+		const char* lineEnd = nl ? nl : last;
+		if (nl == nullptr && !complete)
+			break;	// still being written, the tail will pick it up
+		size_t len = lineEnd - p;
+		if (len > 0 && p[len - 1] == '\r')
+			len--;
+		ParseLine(p, len, entry, scratch);
+		if (lines.empty() || !lines.back()->Append(entry)) {
+			const uint32_t ChunkLines = 16 * 1024;
+			const uint32_t ChunkBytes = 1024 * 1024;
+			lines.push_back(std::make_shared<LogChunk>(0, ChunkLines, std::max(ChunkBytes, LogChunk::BytesNeeded(entry))));
+			lines.back()->Append(entry);
+		}
+		p = nl ? nl + 1 : last;
+		parsedTo = base + (p - data);
+	}
+	return parsedTo;
+}
+
+void LogFile::CheckForLogFile()
+{
+	try {
+		// the directory index is shared with the other logs and only rescans when it's due
+		fs::path latest;
+		if (!directory_->GetLatest(namePrefix_, latest)) {
+			if (buffer_.Size() == 0)
+				AddSystemEntry("Directory does not exist or is not a directory: " + logDir_.string());
 			return;
 		}
+		if (latest == logFile_) {
+			return;	// no file found or we've aleady opened the latest
+		}
+
+		// don't keep retrying a file we can't open
+		if (lastOpenAttempt_ + 2 > time(nullptr))
+			return;
+		if (fs::exists(latest))
+			SwitchTo(latest);
 		else {
-			if (c == '\t')
-				line += "    ";
-			else
-				line += (char)c;
-			if (c == '\n') {
-				AddLogEntry(ParseLine(line));
-				line.clear();
-			}
+			lastOpenAttempt_ = time(nullptr);
+			if (buffer_.Size() == 0)
+				AddSystemEntry("Error loading log file for " + latest.string());
 		}
 	}
+	catch (std::exception& e) {
+		if (buffer_.Size() == 0)
+			AddSystemEntry("Error loading log file for " + namePrefix_ + " - " + std::string(e.what()));
+	}
+}
+
+void LogFile::CheckForRotation()
+{
+	// only called when the file is idle, and not more than once a second
+	if (fp_ == nullptr || lastRotationCheck_ + 1 > time(nullptr))
+		return;
+	lastRotationCheck_ = time(nullptr);
+
+	// copytruncate, the file is now shorter than what we've read
+	struct _stat64 st;
+	if (_fstat64(_fileno(fp_), &st) == 0 && st.st_size < _ftelli64(fp_)) {
+		_fseeki64(fp_, 0, SEEK_SET);
+		reader_.Reset();
+		stats_.truncations++;
+		AddSystemEntry("Log file truncated, reading " + logFile_.string() + " from the beginning");
+		return;
+	}
+
+	// renamed away and a new file created with the same name, we've already read
+	// the old one to the end, so start reading the new one from the beginning
+	FileId id;
+	if (GetFileId(logFile_, id) && id != fileId_)
+		SwitchTo(logFile_);
 }
 
-std::shared_ptr<LogEntry> LogFile::ParseLine(const std::string& line)
+void LogFile::ReadLines()
 {
-	auto entry = std::make_shared<LogEntry>();
-	entry->timestamp = time(nullptr);
-	boost::match_results<std::string::const_iterator> match;
-	if (boost::regex_search(line, match, pattern_, boost::match_default)) {
+	if (fp_ == nullptr)
+		return;
+
+	// the lines from each read go to the subscribers together
+	auto onLine = [this](const char* line, size_t len) { AddLine(line, len); };
+	while (!exiting_ && reader_.Read(fp_, onLine) > 0)
+		FlushEntries();
+}
+
+void LogFile::AddLine(const char* line, size_t len)
+{
+	ParseLine(line, len, parsed_, expanded_);
+	StampEntry(parsed_);
+	AddLogEntry(parsed_);
+	stats_.linesRead++;
+}
+
+int LogFile::Tail()
+{	
+	// free the dropped chunks that snapshots were holding on to last time
+	if (buffer_.RetiredWeight() > 0) {
+		buffer_.Reclaim();
+		bufferBytes_ = buffer_.Weight();
+	}
+	if (paused_)
+		return 0;
+
+	// read what's left in the current file before looking for a newer one,
+	// so nothing is lost when the log rolls over
+	uint64_t linesRead = stats_.linesRead;
+	ReadLines();
+	CheckForLogFile();
+	if (stats_.linesRead == linesRead)
+		CheckForRotation();
+	ReadLines();
+	if (index_)
+		index_->Extend();
+	return (int)(stats_.linesRead - linesRead);
+}
+
+void LogFile::ParseLine(const char* line, size_t len, LogEntry& entry, std::string& scratch) const
+{
+	if (memchr(line, '\t', len) != nullptr) {
+		scratch.clear();
+		for (const char* p = line; p < line + len; p++) {
+			if (*p == '\t')
+				scratch += "    ";
+			else
+				scratch += *p;
+		}
+		line = scratch.data(), len = scratch.size();
+	}
+
+	entry.Clear();
+	entry.timestamp = time(nullptr);
+	bool parsed = false;
+	if (!cfgSvc_) {
+		parsed = ParseControllerLine(line, len, entry);
+#ifdef _DEBUG
+		// keep the fast path honest, it must agree with the regex
+		boost::cmatch check;
+		bool matched = boost::regex_search(line, line + len, check, pattern_, boost::match_single_line);
+		assert(!parsed || (matched && check.str(2) == TimeText(entry.time).c_str() && entry.body == check.str(3)));
+#endif
+	}
+
+	// lines that don't start with a digit can't match the controller pattern, skip the regex for those
+	boost::cmatch match;
+	if (!parsed && (cfgSvc_ || (len > 0 && (unsigned char)(line[0] - '0') <= 9))
+		&& boost::regex_search(line, line + len, match, pattern_, boost::match_single_line)) {
 		if (!cfgSvc_) {
-			entry->type = MessageType::normal;
-			entry->time = std::string(match[2].first, match[2].second);
-			entry->tid = atoi(std::string(match[1].first, match[1].second).c_str());
-			entry->body = std::string(match[3].first, match[3].second);
+			entry.type = MessageType::normal;
+			entry.time = ParseTimeOfDay(match[2].first);
+			entry.tid = atoi(std::string(match[1].first, match[1].second).c_str());
+			entry.body.assign(match[3].first, match[3].second);
 		}
 		else {
-			entry->type = MessageType::cfgSvc;
-			entry->time = std::string(match[2].first, match[2].second);
-			entry->severity = std::string(match[3].first, match[3].second);
-			entry->id = std::string(match[4].first, match[4].second);
-			entry->body = std::string(match[5].first, match[5].second);
+			entry.type = MessageType::cfgSvc;
+			entry.time = ParseTimeOfDay(match[2].first);
+			entry.day = ParseDate(match[1].first);
+			entry.severity.assign(match[3].first, match[3].second);
+			entry.id.assign(match[4].first, match[4].second);
+			entry.body.assign(match[5].first, match[5].second);
 		}
+		parsed = true;
+	}
 
-		try {
-			auto duration = ts::duration_from_string(entry->time);
-			if (lastDuration_ != ts::time_duration())
-				entry->duration = duration - lastDuration_;
-			lastDuration_ = duration;
-		}
-		catch (std::exception&) {}
+	if (!parsed) {
+		entry.type = MessageType::continuation;
+		entry.body.assign(line, len);
 	}
-	else {
-		entry->type = MessageType::continuation;
-		entry->body = line;
+}
+
+int LogFile::NumLines() const
+{
+	auto index = GetIndex();
+	if (index && index->Ready() && index->NumLines() > 0)
+		return (int)std::min<uint64_t>(index->NumLines(), std::numeric_limits<int>::max());
+	return numLines_.load(std::memory_order_acquire);
+}
+
+LogEntryPtr LogFile::GetIndexedEntry(const LineIndex& index, uint64_t line) const
+{
+	auto entry = index.GetParsed(line);
+	if (entry)
+		return entry;
+
+	std::string text, scratch;
+	if (!index.ReadLine(line, text))
+		return nullptr;
+	entry = std::make_shared<LogEntry>();
+	ParseLine(text.data(), text.size(), *entry, scratch);
+
+	// the lines aren't read in order so there's nothing to stamp them from, the day is
+	// when the file was written (or the day before for a time later than that) and the
+	// duration is from the line before if it has a time
+	if (entry->time >= 0) {
+		if (!cfgSvc_)
+			entry->day = index.Day() - (index.FileTime() >= 0 && entry->time > index.FileTime() + 60 * 1000 ? 1 : 0);
+		auto prev = line > 0 ? index.GetParsed(line - 1) : nullptr;
+		if (prev == nullptr && line > 0 && index.ReadLine(line - 1, text)) {
+			prev = std::make_shared<LogEntry>();
+			ParseLine(text.data(), text.size(), *prev, scratch);
+		}
+		if (prev && prev->time >= 0) {
+			entry->duration = entry->time - prev->time;
+			if (entry->duration < 0)
+				entry->duration += MsPerDay;
+		}
 	}
+	index.AddParsed(line, entry);
 	return entry;
 }
 
+void LogFile::StampEntry(LogEntry& entry)
+{
+	if (entry.time < 0)
+		return;
+
+	if (!cfgSvc_) {
+		if (lastStamp_ < 0) {
+			// first line since the file was opened, if it's later in the day than the file was
+			// last written then it was written before midnight (allow a minute for clock skew)
+			if (fileTime_ >= 0 && entry.time > fileTime_ + 60 * 1000)
+				day_--;
+		}
+		else if (entry.time < lastStamp_ % MsPerDay - MsPerDay / 2) {
+			// time went back by more than half a day, we've gone past midnight
+			day_++;
+		}
+		entry.day = day_;
+	}
+	else if (entry.day < 0)
+		entry.day = day_;
+	else
+		day_ = entry.day;
+
+	auto stamp = MakeStamp(entry.day, entry.time);
+	if (lastStamp_ >= 0)
+		entry.duration = (int)(stamp - lastStamp_);
+	lastStamp_ = stamp;
+}
@@ -5,43 +5,91 @@
 #include <boost/signals2/signal.hpp>
 #include <filesystem>
 #include <shared_mutex>
+#include <atomic>
+#include <deque>
 #include "utils.h"
-
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include "linereader.h"
+#include "logtime.h"
+#include "logdirectory.h"
+#include "logentry.h"
+#include "lineindex.h"
+#include "timeindex.h"
+#include "seqring.h"
+#include "spillstore.h"
 
 namespace fs = boost::filesystem;
-namespace ts = boost::posix_time;
 
-enum class MessageType { normal, continuation, cfgSvc, system, separator };
+class LogFile;
+typedef std::shared_ptr<LogFile> LogFilePtr;
+typedef boost::signals2::signal<void(LogFilePtr, const LogEntrySpan&)> LogEntriesSignal;
 
-struct LogEntry
+// identifies a file independently of its name, so we can tell when a log has been
+// renamed away and replaced by a new file with the same name
+struct FileId
 {
-	MessageType type = MessageType::normal;
-	time_t timestamp = 0;
-	std::string time;
-	std::string body;
-	int tid = 0;
-	ts::time_duration duration;
-
-	// for config service
-	std::string severity;
-	std::string id;
+	DWORD volume = 0;
+	uint64_t index = 0;
+
+	bool operator==(const FileId& rhs) const { return volume == rhs.volume && index == rhs.index; }
+	bool operator!=(const FileId& rhs) const { return !(*this == rhs); }
 };
 
-typedef std::shared_ptr<LogEntry> LogEntryPtr;
+// counters for what happened while tailing, so we know when lines could have been missed,
+// the tailer updates them while the views read them, each is read on its own (relaxed)
+struct TailStats
+{
+	std::atomic<uint64_t> linesRead{ 0 };
+	std::atomic<uint64_t> bytesSkipped{ 0 };	// not read because we only read the end of a file when first opened
+	std::atomic<int> rotations{ 0 };			// switched to a new file after reading the previous one to the end
+	std::atomic<int> truncations{ 0 };			// file shrank under us (copytruncate), restarted from the beginning
+	std::atomic<int> partialLines{ 0 };			// unterminated lines flushed when switching files
+	std::atomic<bool> spillFailed{ false };		// dropped lines couldn't be spilled to disk, history stops at the buffer
+};
 
-class LogFile;
-typedef std::shared_ptr<LogFile> LogFilePtr;
+// reading back through the current and rotated logs when a log is first opened
+struct BackfillOptions
+{
+	int64_t maxBytes = 0;	// total to read across all the files, 0 for no limit
+	int minutes = 0;		// only keep lines from the last n minutes, 0 for no limit
+
+	bool Enabled() const { return maxBytes > 0 || minutes > 0; }
+};
 
-class LockBuffer
+// A view of the lines in a log as they were when it was taken, for drawing a
+// frame. The tailer carries on appending and the lines that can be seen
+// through the snapshot aren't freed until it goes away.
+class LogSnapshot
 {
-	Spinlock lock;
-	//std::unique_lock<std::shared_mutex> lock;
+	const LogFile& file_;
+	LineIndexPtr index_;	// set when we're showing the whole file through its index
+	mutable std::vector<LogEntryPtr> indexed_;	// the lines parsed from it, kept for the views we gave out
+	SeqRing<LogChunk>::Reader reader_;
+	const SpillStore& spill_;
+	std::vector<const LogChunk*> chunks_;
+	std::vector<int> starts_;	// index of the first line in each chunk
+	uint64_t firstLine_ = 0;	// line number of index 0
+	int spilledLines_ = 0;		// lines before the ones in memory, they're read back from disk
+	int numLines_ = 0;
+	mutable std::shared_ptr<const char> block_;		// the last chunk read back
+	mutable uint64_t blockFirst_ = 0;
+
 public:
-	LockBuffer(LogFile& logfile);
-	LockBuffer(LogFilePtr logfile);
-};
+	LogSnapshot(const LogFile& logfile);
+	LogSnapshot(const LogFilePtr& logfile) : LogSnapshot(*logfile) {}
 
+	int NumLines() const { return numLines_; }
+	// the view is valid for as long as the snapshot is
+	bool GetEntry(int idx, LogEntryView& entry) const;
+
+	// index of the first line at or after a stamp, the last line if they're all
+	// earlier, -1 if there are no lines
+	int FindTime(int64_t stamp) const;
+	// the same for the latest time of day that isn't after the last line
+	int FindTimeOfDay(int time) const;
+
+private:
+	int FindIndexedTime(int64_t stamp) const;
+};
 
 
 class LogFile : public std::enable_shared_from_this<LogFile>
@@ -51,55 +99,112 @@ class LogFile : public std::enable_shared_from_this<LogFile>
 	bool cfgSvc_;
 	fs::path logDir_;
 	std::string namePrefix_;
+	LogDirectoryPtr directory_;	// shared with the other log files in the same directory
 	fs::path logFile_;		// current log file opened
-
-	// we only buffer so many lines to display
-	boost::circular_buffer<LogEntryPtr> buffer_;
+	FileId fileId_;			// identity of the file we have open
+	LineReader reader_;
+	std::string expanded_;	// scratch buffer for lines with tabs
+
+	// we only buffer so many lines to display, they're kept in chunks that are dropped
+	// as a whole, the tailer appends and the views read through a LogSnapshot without
+	// either of them waiting on the other
+	SeqRing<LogChunk> buffer_;
+	struct ChunkInfo
+	{
+		LogChunkPtr chunk;
+		size_t bytes;		// its footprint
+	};
+	LogChunkPtr current_;				// the chunk being appended to
+	std::deque<ChunkInfo> chunkInfo_;	// one for each chunk in the buffer, oldest first
+	uint64_t lines_ = 0;				// lines appended so far
+	uint64_t firstLine_ = 0;			// the oldest line we still have, in memory or on disk
+	std::unique_ptr<SpillStore> spill_;	// where the chunks go when they drop out of the buffer
+	bool indexed_ = false;				// index the whole file so the views can show all of it
+	LineIndexPtr index_;				// only swapped on the tailer thread, the views take a copy
+	TimeIndex times_;					// the line at each time, for going to a time
+	std::atomic<int> numLines_;
+	std::atomic<size_t> bufferBytes_;	// memory held by the chunks in the buffer and those waiting to be freed
+	std::atomic<size_t> budget_;		// how much it's allowed, set by the tailer
+	std::atomic<uint64_t> bytesAppended_;	// text appended so far, for the ingest rate
+	LogEntry parsed_;	// reused for each line read so its strings keep their capacity
 	bool exiting_ = false;
 	bool paused_ = false;
 
-	friend class LockBuffer;
-	//mutable std::shared_mutex lock_;
-	mutable std::atomic_flag lock_;
+	friend class LogSnapshot;
 
-	time_t lastLogCheck_ = 0;	// last time we checked for a new log
+	time_t lastOpenAttempt_ = 0;	// last time we failed to open a log
+	time_t lastRotationCheck_ = 0;	// last time we checked if the open file was rotated or truncated
+	TailStats stats_;
+	BackfillOptions backfill_;
 
-	boost::signals2::signal<void(LogFilePtr, LogEntryPtr)> subscribers_;
+	// the subscribers get the entries in batches, a read's worth at a time, the
+	// entries are copied into pending_ so their strings keep their capacity
+	LogEntriesSignal subscribers_;
+	bool subscribed_ = false;
+	std::vector<LogEntry> pending_;
+	size_t numPending_ = 0;
 
-	// last timestamp or duration read
-	ts::time_duration lastDuration_;
+	// day of the lines being read, the controller logs only have a time of day so
+	// this starts at the date the file was last written and follows midnight rollovers
+	int day_ = 0;
+	int fileTime_ = -1;		// time of day the file was last written when opened
+	int64_t lastStamp_ = -1;	// stamp of the last entry with a time
 
 public:
-	LogFile(fs::path logDir, std::string namePrefix, bool cfgSvc=false, int bufSize=10000);
+	LogFile(fs::path logDir, std::string namePrefix, bool cfgSvc=false);
 	~LogFile();
 
 	fs::path Filename() const { return logFile_; }
-	void Close();
-	void Tail();
-	void Pause(bool pause) { paused_ = pause; }
-	int NumLines() const { return (int)buffer_.size(); }
-	std::shared_ptr<LogEntry> GetEntry(int idx) const
+	fs::path Directory() const { return logDir_; }
+	LogDirectoryPtr GetLogDirectory() const { return directory_; }
+	bool MatchesName(const std::string& filename) const
 	{
-		Spinlock spinlock(lock_);
-		//std::unique_lock lock(lock_);
-		return buffer_[idx];
+		return _strnicmp(filename.c_str(), namePrefix_.c_str(), namePrefix_.size()) == 0;
 	}
+	void Close();
+	int Tail();
+	void Pause(bool pause) { paused_ = pause; }
+	const TailStats& GetStats() const { return stats_; }
+	void SetBackfill(const BackfillOptions& options) { backfill_ = options; }
+	// the lines we've read are still buffered as usual, the views show the whole
+	// file through the index once it's built and parse just the lines they draw
+	void SetIndexed(bool indexed) { indexed_ = indexed; }
+	LineIndexPtr GetIndex() const { return std::atomic_load(&index_); }
+	LogEntryPtr GetIndexedEntry(const LineIndex& index, uint64_t line) const;
+	// the lines in the index once it's built, otherwise the ones we've buffered
+	int NumLines() const;
+
+	// the oldest chunks are dropped once the buffer goes over budget, it's always
+	// left with a couple so there's something to show however small the budget
+	void SetBudget(size_t bytes) { budget_.store(bytes, std::memory_order_relaxed); }
+	size_t GetBudget() const { return budget_.load(std::memory_order_relaxed); }
+	size_t BufferBytes() const { return bufferBytes_.load(std::memory_order_relaxed); }
+	uint64_t BytesAppended() const { return bytesAppended_.load(std::memory_order_relaxed); }
 	void SetExiting(bool exiting) { exiting_ = exiting; }
-	void AddLogEntry(LogEntryPtr entry)
-	{
-		Spinlock spinlock(lock_);
-		buffer_.push_back(entry);
-		subscribers_(shared_from_this(), entry);
-	}
+	// only called on the tailer thread, the entries aren't counted or passed on
+	// to the subscribers until they're flushed
+	void AddLogEntry(const LogEntry& entry);
+	void FlushEntries();
 	bool IsConfigService() const { return cfgSvc_; }
-	boost::signals2::signal<void(LogFilePtr, LogEntryPtr)>& GetSignal() { return subscribers_; }
+	// connect before the log is tailed
+	boost::signals2::connection Subscribe(const LogEntriesSignal::slot_type& slot);
 
 private:
 	void CheckForLogFile();
-	bool Open(const char* filename);
-	LogEntryPtr ParseLine(const std::string& line);
+	void CheckForRotation();
+	bool Open(const char* filename, bool fromStart);
+	void SwitchTo(const fs::path& filename);
+	void ReadLines();
+	void AddSystemEntry(const std::string& text);
+	void AddLine(const char* line, size_t len);
+	void DropOldestChunk();
+	bool Backfill(const fs::path& current);
+	// parses the lines that start in [begin, end), returns the offset after the last one or -1 if there were none
+	int64_t ParseChunk(const fs::path& path, int64_t begin, int64_t end, int64_t limit, bool complete,
+		std::vector<LogChunkPtr>& lines) const;
+
+	// parsing has no side effects so it can run on several threads, StampEntry
+	// then works out the day and duration and has to see the lines in order
+	void ParseLine(const char* line, size_t len, LogEntry& entry, std::string& scratch) const;
+	void StampEntry(LogEntry& entry);
 };
-
-inline LockBuffer::LockBuffer(LogFile& logfile) : lock(logfile.lock_) {}
-inline LockBuffer::LockBuffer(LogFilePtr logfile) : lock(logfile->lock_) {}
-
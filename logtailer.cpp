@@ -1,29 +1,218 @@
+
 #include "logtailer.h"
+#include <algorithm>
 #include <thread>
 
+using namespace std::chrono_literals;
+
+// a busy log is polled every MinInterval, each poll that finds nothing doubles
+// the interval up to the maximum. Change notifications on a directory are lazy
+// for files held open by the writer, so watched files still get a slow poll.
+static const auto MinInterval = std::chrono::milliseconds(5);
+static const auto MaxWatchedInterval = std::chrono::milliseconds(500);
+static const auto MaxPolledInterval = std::chrono::milliseconds(200);
+static const auto WatchRetryInterval = std::chrono::seconds(5);
+static const auto RebalanceInterval = std::chrono::seconds(1);
+// there's little point in more threads than logs, or more than a few between them
+static const unsigned MaxThreads = 8;
+
 LogTailer::LogTailer()
 	: exiting_(false)
 {
+	wakeEvent_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	updateEvent_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+}
 
+LogTailer::~LogTailer()
+{
+	CloseHandle(wakeEvent_);
+	CloseHandle(updateEvent_);
 }
 
 void LogTailer::AddLogFile(std::shared_ptr<LogFile> logfile)
 {
-	logfiles_.push_back(logfile);
+	sources_.emplace_back();
+	auto& source = sources_.back();
+	source.file = logfile;
+	source.nextPoll = Clock::now();
+	source.interval = MinInterval;
+
+	auto it = std::find_if(dirs_.begin(), dirs_.end(), [&](const WatchedDirectory& dir) {
+		return dir.index == logfile->GetLogDirectory();
+	});
+	if (it == dirs_.end()) {
+		dirs_.push_back(WatchedDirectory());
+		it = dirs_.end() - 1;
+		it->index = logfile->GetLogDirectory();
+	}
+	it->sources.push_back(sources_.size() - 1);
 }
 
 void LogTailer::Run()
 {
+	// start with an even split until we know how fast each log grows
+	lastRebalance_ = Clock::now();
+	Rebalance(lastRebalance_);
+	unsigned threads = std::min({ std::max(1u, std::thread::hardware_concurrency()), MaxThreads, (unsigned)std::max<size_t>(1, sources_.size()) });
+	pool_.reset(new WorkPool(threads));
 	tailThread_ = std::thread(&LogTailer::DoTail, this);
 }
 
+void LogTailer::Shutdown()
+{
+	exiting_ = true;
+	SetEvent(wakeEvent_);
+	tailThread_.join();
+	if (pool_)
+		pool_->Shutdown();
+}
+
+void LogTailer::StartWatchers()
+{
+	// directories that don't exist yet can't be watched, try again every so often
+	lastWatchAttempt_ = Clock::now();
+	for (auto& dir : dirs_) {
+		if (dir.watcher && dir.watcher->IsValid())
+			continue;
+		dir.watcher.reset(new DirectoryWatcher(dir.index->Directory()));
+		bool valid = dir.watcher->IsValid();
+		if (!valid)
+			dir.watcher.reset();
+		dir.index->SetWatched(valid);
+		for (auto idx : dir.sources)
+			sources_[idx].watched = valid;
+	}
+}
+
+void LogTailer::OnDirectoryChanged(WatchedDirectory& dir)
+{
+	std::vector<std::string> names;
+	bool complete = dir.watcher->GetChanges(names);
+	if (!dir.watcher->IsValid()) {
+		dir.watcher.reset();
+		dir.index->SetWatched(false);
+		complete = false;
+	}
+	dir.index->OnChanged(names, complete);
+
+	// wake only the log files the changes are for
+	auto now = Clock::now();
+	for (auto idx : dir.sources) {
+		auto& source = sources_[idx];
+		bool changed = !complete || std::any_of(names.begin(), names.end(), [&](const std::string& name) {
+			return source.file->MatchesName(name);
+		});
+		if (changed) {
+			// a busy source is polled again as soon as the worker's done with it
+			if (source.busy.load(std::memory_order_acquire))
+				source.woken = true;
+			else {
+				source.nextPoll = now;
+				source.interval = MinInterval;
+			}
+		}
+		source.watched = dir.watcher != nullptr;
+	}
+}
+
+// runs on the pool, the source is ours until busy is cleared
+void LogTailer::Poll(Source& source)
+{
+	if (!exiting_ && source.file->Tail() > 0) {
+		source.interval = MinInterval;
+		SetEvent(updateEvent_);
+	}
+	else {
+		auto maxInterval = source.watched ? MaxWatchedInterval : MaxPolledInterval;
+		source.interval = std::min<Clock::duration>(source.interval * 2, maxInterval);
+	}
+	if (source.woken.exchange(false))
+		source.interval = MinInterval;
+	source.nextPoll = Clock::now() + source.interval;
+	source.busy.store(false, std::memory_order_release);
+	// the scheduler doesn't wait on busy sources, let it see when this one is due
+	SetEvent(wakeEvent_);
+}
+
+void LogTailer::Rebalance(Clock::time_point now)
+{
+	if (sources_.empty())
+		return;
+
+	double seconds = std::chrono::duration<double>(now - lastRebalance_).count();
+	lastRebalance_ = now;
+	double total = 0;
+	for (auto& source : sources_) {
+		uint64_t bytes = source.file->BytesAppended();
+		if (seconds > 0) {
+			double rate = (bytes - source.lastBytes) / seconds;
+			source.rate = source.rate * 0.75 + rate * 0.25;
+		}
+		source.lastBytes = bytes;
+		total += source.rate;
+	}
+
+	// half the budget is split evenly so quiet logs keep some history, the rest goes
+	// by how fast each log is growing in bytes, so long lines count for more than short
+	size_t even = budget_ / 2 / sources_.size();
+	size_t shared = budget_ - even * sources_.size();
+	for (auto& source : sources_) {
+		double share = total > 0 ? source.rate / total : 1.0 / sources_.size();
+		source.file->SetBudget(even + (size_t)(shared * share));
+	}
+}
+
 void LogTailer::DoTail()
 {
-	using namespace std::chrono_literals;
+	StartWatchers();
+
+	std::vector<HANDLE> handles;
+	std::vector<WatchedDirectory*> handleDirs;
 	while (!exiting_) {
-		for (auto file : logfiles_) {
-			file->Tail();
+		auto now = Clock::now();
+		for (auto& source : sources_) {
+			if (exiting_)
+				return;
+			if (source.busy.load(std::memory_order_acquire))
+				continue;
+			// a change can come in after the worker last looked at woken but before it
+			// gave the source back, so it's checked here too or the wake waits for nextPoll
+			if (source.woken.exchange(false)) {
+				source.nextPoll = now;
+				source.interval = MinInterval;
+			}
+			if (source.nextPoll <= now) {
+				source.busy = true;
+				auto src = &source;
+				pool_->Submit([this, src]() { Poll(*src); });
+			}
+		}
+
+		if (now - lastWatchAttempt_ > WatchRetryInterval)
+			StartWatchers();
+		if (now - lastRebalance_ > RebalanceInterval)
+			Rebalance(now);
+
+		// sleep until the next poll is due, a directory changes or we're shutting down
+		now = Clock::now();
+		auto next = now + MaxWatchedInterval;
+		for (const auto& source : sources_) {
+			if (!source.busy.load(std::memory_order_acquire))
+				next = std::min(next, source.nextPoll);
 		}
-		std::this_thread::sleep_for(100ms);
+		auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+
+		handles.assign(1, wakeEvent_);
+		handleDirs.assign(1, nullptr);
+		for (auto& dir : dirs_) {
+			if (dir.watcher && handles.size() < MAXIMUM_WAIT_OBJECTS) {
+				handles.push_back(dir.watcher->GetEvent());
+				handleDirs.push_back(&dir);
+			}
+		}
+
+		DWORD res = WaitForMultipleObjects((DWORD)handles.size(), handles.data(), FALSE, (DWORD)std::max<long long>(timeout, 0));
+		if (res > WAIT_OBJECT_0 && res < WAIT_OBJECT_0 + handles.size())
+			OnDirectoryChanged(*handleDirs[res - WAIT_OBJECT_0]);
 	}
 }
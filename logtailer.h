@@ -1,23 +1,75 @@
 #pragma once
 
 #include "logfile.h"
+#include "dirwatcher.h"
+#include "workpool.h"
+#include <atomic>
+#include <deque>
+#include <chrono>
 #include <vector>
 #include <thread>
 
 class LogTailer
 {
-	std::vector<std::shared_ptr<LogFile>> logfiles_;
+	typedef std::chrono::steady_clock Clock;
+
+	// each log file is polled on its own schedule, quickly while it's busy and
+	// backing off while it's idle, a change notification makes it due straight away.
+	// A due file is tailed on the pool, while it's busy the worker tailing it owns
+	// its schedule and the scheduler leaves it alone, so it's never on two threads.
+	struct Source
+	{
+		std::shared_ptr<LogFile> file;
+		std::atomic<bool> busy;				// queued or being tailed
+		std::atomic<bool> woken;			// changed while it was busy, poll again as soon as it isn't
+		std::atomic<bool> watched;
+		Clock::time_point nextPoll;			// owned by whoever has the source
+		Clock::duration interval;
+		uint64_t lastBytes = 0;		// bytes appended at the last rebalance
+		double rate = 0;			// smoothed bytes per second appended
+
+		Source() : busy(false), woken(false), watched(false) {}
+	};
+
+	struct WatchedDirectory
+	{
+		LogDirectoryPtr index;
+		std::unique_ptr<DirectoryWatcher> watcher;
+		std::vector<size_t> sources;	// index into sources_
+	};
+
+	std::deque<Source> sources_;	// doesn't move them, the pool holds pointers
+	std::vector<WatchedDirectory> dirs_;
 
 public:
+	static const size_t DefaultBudget = 64 * 1024 * 1024;
+
 	LogTailer();
+	~LogTailer();
 	void AddLogFile(std::shared_ptr<LogFile> logfile);
 	void Run();
-	void Shutdown() { exiting_ = true; tailThread_.join(); }
+	void Shutdown();
+
+	// memory for all the log buffers between them
+	void SetBudget(size_t bytes) { budget_ = bytes; }
+	size_t GetBudget() const { return budget_; }
+
+	// signalled whenever new lines have been read
+	HANDLE GetUpdateEvent() const { return updateEvent_; }
 
 private:
-	bool exiting_ = false;
+	std::atomic<bool> exiting_;
+	HANDLE wakeEvent_;
+	HANDLE updateEvent_;
 	std::thread tailThread_;
+	std::unique_ptr<WorkPool> pool_;
+	Clock::time_point lastWatchAttempt_;
+	Clock::time_point lastRebalance_;
+	size_t budget_ = DefaultBudget;
 
 	void DoTail();
+	void StartWatchers();
+	void OnDirectoryChanged(WatchedDirectory& dir);
+	void Poll(Source& source);
+	void Rebalance(Clock::time_point now);
 };
-
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+
+// Times in the logs are kept as milliseconds since midnight plus a day number
+// (days since 1970-01-01), they are only turned into text when drawn.
+
+const int MsPerDay = 24 * 60 * 60 * 1000;
+
+// absolute time in ms, used for ordering and durations across midnight
+inline int64_t MakeStamp(int day, int time) { return (int64_t)day * MsPerDay + time; }
+
+// Parses "HH:MM:SS.mmm" (p must have at least 12 bytes), returns milliseconds since
+// midnight or -1 if malformed.
+// The "HH:MM:SS" part is validated and converted 8 bytes at a time (SWAR).
+inline int ParseTimeOfDay(const char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));	// little endian, p[0] is the low byte
+
+	// every byte is 0x3?, digits are 0-9 and the separators are ':' (0x3a)
+	const uint64_t HighNibbles = 0xf0f0f0f0f0f0f0f0ull;
+	const uint64_t DigitsPlus6 = 0x0606000606000606ull;
+	const uint64_t ColonNibbles = 0x00000f00000f0000ull;
+	if ((v & HighNibbles) != 0x3030303030303030ull
+		|| ((v + DigitsPlus6) & HighNibbles) != 0x3030303030303030ull
+		|| (v & ColonNibbles) != 0x00000a00000a0000ull)
+		return -1;
+
+	// combine each pair of digits, byte n becomes d[n] * 10 + d[n + 1]
+	uint64_t d = v - 0x3030303030303030ull;
+	uint64_t pairs = d * 10 + (d >> 8);
+	int hours = (int)(pairs & 0xff);
+	int minutes = (int)((pairs >> 24) & 0xff);
+	int seconds = (int)((pairs >> 48) & 0xff);
+
+	const unsigned char* ms = reinterpret_cast<const unsigned char*>(p + 8);
+	if (ms[0] != '.' || (unsigned char)(ms[1] - '0') > 9 || (unsigned char)(ms[2] - '0') > 9 || (unsigned char)(ms[3] - '0') > 9)
+		return -1;
+	if (hours > 23 || minutes > 59 || seconds > 59)
+		return -1;
+	int millis = (ms[1] - '0') * 100 + (ms[2] - '0') * 10 + (ms[3] - '0');
+	return ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+}
+
+// days since 1970-01-01 of a civil date
+inline int DaysFromCivil(int y, int m, int d)
+{
+	y -= m <= 2;
+	int era = (y >= 0 ? y : y - 399) / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+// Parses "YYYY-MM-DD" (p must have at least 10 bytes), returns days since 1970-01-01 or -1 if malformed.
+inline int ParseDate(const char* p)
+{
+	for (int i : { 0, 1, 2, 3, 5, 6, 8, 9 }) {
+		if ((unsigned char)(p[i] - '0') > 9)
+			return -1;
+	}
+	if (p[4] != '-' || p[7] != '-')
+		return -1;
+	int y = (p[0] - '0') * 1000 + (p[1] - '0') * 100 + (p[2] - '0') * 10 + (p[3] - '0');
+	int m = (p[5] - '0') * 10 + (p[6] - '0');
+	int d = (p[8] - '0') * 10 + (p[9] - '0');
+	return DaysFromCivil(y, m, d);
+}
+
+// local day number and time of day of a time_t
+inline void LocalDayAndTime(time_t t, int& day, int& timeOfDay)
+{
+	struct tm tm;
+#ifdef _WIN32
+	localtime_s(&tm, &t);
+#else
+	localtime_r(&t, &tm);
+#endif
+	day = DaysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+	timeOfDay = ((tm.tm_hour * 60 + tm.tm_min) * 60 + tm.tm_sec) * 1000;
+}
+
+// formats milliseconds as "HH:MM:SS.mmm", empty if the time is unknown (< 0)
+class TimeText
+{
+	char text_[16];
+
+public:
+	explicit TimeText(int ms)
+	{
+		if (ms < 0) {
+			text_[0] = 0;
+			return;
+		}
+		int h = ms / 3600000, m = ms / 60000 % 60, s = ms / 1000 % 60, f = ms % 1000;
+		text_[0] = (char)('0' + h / 10 % 10);
+		text_[1] = (char)('0' + h % 10);
+		text_[2] = ':';
+		text_[3] = (char)('0' + m / 10);
+		text_[4] = (char)('0' + m % 10);
+		text_[5] = ':';
+		text_[6] = (char)('0' + s / 10);
+		text_[7] = (char)('0' + s % 10);
+		text_[8] = '.';
+		text_[9] = (char)('0' + f / 100);
+		text_[10] = (char)('0' + f / 10 % 10);
+		text_[11] = (char)('0' + f % 10);
+		text_[12] = 0;
+	}
+
+	const char* c_str() const { return text_; }
+};
+
+// The time by the logs rather than by this machine's clock, in seconds since 1970
+// local time. It's the latest line seen, and while the logs are quiet it carries on
+// from there as the time passes here, so the two clocks being apart by a skewed host,
+// a share on another machine or a backfill doesn't matter. Safe on any thread.
+class LogClock
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<int64_t> latest_;	// second of the latest line, -1 before the first
+	std::atomic<int64_t> seenAt_;	// when it was seen, in Clock's milliseconds
+
+	static int64_t Millis()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+public:
+	LogClock() : latest_(-1), seenAt_(0) {}
+
+	static int64_t Second(int day, int time) { return (int64_t)day * 24 * 60 * 60 + time / 1000; }
+
+	// a line logged at second, the clock only goes forward
+	void Observe(int64_t second)
+	{
+		int64_t latest = latest_.load(std::memory_order_relaxed);
+		while (second > latest) {
+			if (latest_.compare_exchange_weak(latest, second, std::memory_order_relaxed)) {
+				seenAt_.store(Millis(), std::memory_order_relaxed);
+				break;
+			}
+		}
+	}
+
+	// -1 until a line has been seen
+	int64_t Now() const
+	{
+		int64_t latest = latest_.load(std::memory_order_relaxed);
+		if (latest < 0)
+			return -1;
+		int64_t idle = (Millis() - seenAt_.load(std::memory_order_relaxed)) / 1000;
+		return latest + std::max<int64_t>(0, idle);
+	}
+};
@@ -51,6 +51,19 @@ void LogView::SetSearchPattern(const std::string& searchPattern)
 	}
 }
 
+bool LogView::GotoTime(int time)
+{
+	LogSnapshot snapshot(file_);
+	int idx = snapshot.FindTimeOfDay(time);
+	if (idx < 0)
+		return false;
+	row_ = idx;
+	tail_ = false;
+	file_->Pause(!tail_);
+	SetPosition();
+	return true;
+}
+
 bool LogView::Update(int c)
 {
 	const int pageSize = LINES - 6;
@@ -135,44 +148,44 @@ void LogView::Resize()
 
 void LogView::Render()
 {
-	LockBuffer lock(file_);
+	LogSnapshot snapshot(file_);
 	int maxy, maxx;
 	getmaxyx(*win_, maxy, maxx);
-	int maxEntries = std::min(maxy, file_->NumLines());
+	int maxEntries = std::min(maxy, snapshot.NumLines());
 
 	int tsWidth = 20;
 	int margin = 2;
 	int bodyWidth = maxx - tsWidth - margin;
 
 	if (tail_) 
-		row_ = file_->NumLines() < maxy ? 0 : file_->NumLines() - maxy;
+		row_ = snapshot.NumLines() < maxy ? 0 : snapshot.NumLines() - maxy;
 	int start = row_;
 
-	std::string lastTimestamp;
+	int lastSecond = -1;
 	int tid = 0;
 	int tidCtr = 0;
 	int lastNoneEmptyLine = 0;
 	int lastMarker = 0;
 
 	for (int i = 0; i < maxy; i++, start++) {
-		if (start < file_->NumLines()) {
-			auto entry = file_->GetEntry(start);
+		LogEntryView entry;
+		if (snapshot.GetEntry(start, entry)) {
 
-			if (entry->type == MessageType::system) {
+			if (entry.type == MessageType::system) {
 				win_->AttrOn(COLOR_PAIR(LM_SYSTEM_MESSAGE));
 				win_->MvAddch(i, 1, ACS_DIAMOND);
-				win_->PrintF(i, margin, (int)entry->body.size() + 1, " %s", entry->body.c_str());
+				win_->PrintF(i, margin, (int)entry.body.size() + 1, " %s", entry.body.c_str());
 				win_->AttrOff(COLOR_PAIR(LM_SYSTEM_MESSAGE));
 				win_->ClearToEol();
 				continue;
 			}
-			else if (entry->type == MessageType::normal) {
+			else if (entry.type == MessageType::normal) {
 				win_->AttrOn(COLOR_PAIR(LM_THREAD_ID));
-				win_->PrintF(i, margin, 6, "%05d ", entry->tid);
+				win_->PrintF(i, margin, 6, "%05d ", entry.tid);
 				win_->AttrOff(COLOR_PAIR(LM_THREAD_ID));
-				auto ts = entry->time.substr(0, 8);
+				int second = entry.time < 0 ? -1 : entry.time / 1000;
 				bool resetBold = false;
-				if (!displayDuration_ && !lastTimestamp.empty() && ts != lastTimestamp) {
+				if (!displayDuration_ && lastSecond >= 0 && second != lastSecond) {
 					// highlight the start of a new second, but don't do it for the 1st line, otherwise, that's always bold
 					win_->AttrOn(A_BOLD);
 					resetBold = true;
@@ -181,22 +194,27 @@ void LogView::Render()
 				if (displayDuration_) {
 					win_->Move(i, margin + 6);
 
-					if (!resetBold && entry->duration.hours() > 0) win_->AttrOn(A_BOLD), resetBold = true;
-					win_->PrintF("%02d:", entry->duration.hours());
+					int hours = entry.duration / 3600000;
+					int minutes = entry.duration / 60000 % 60;
+					int seconds = entry.duration / 1000 % 60;
+					int millis = entry.duration % 1000;
+
+					if (!resetBold && hours > 0) win_->AttrOn(A_BOLD), resetBold = true;
+					win_->PrintF("%02d:", hours);
 
-					if (!resetBold && entry->duration.minutes() > 0) win_->AttrOn(A_BOLD), resetBold = true;
-					win_->PrintF("%02d:", entry->duration.minutes());
+					if (!resetBold && minutes > 0) win_->AttrOn(A_BOLD), resetBold = true;
+					win_->PrintF("%02d:", minutes);
 
-					if (!resetBold && entry->duration.seconds() > 0) win_->AttrOn(A_BOLD), resetBold = true;
-					win_->PrintF("%02d.", entry->duration.seconds());
+					if (!resetBold && seconds > 0) win_->AttrOn(A_BOLD), resetBold = true;
+					win_->PrintF("%02d.", seconds);
 					
-					if (!resetBold && entry->duration.fractional_seconds() / 1000 > 0) win_->AttrOn(A_BOLD), resetBold = true;
-					win_->PrintF("%03d", entry->duration.fractional_seconds() / 1000);
+					if (!resetBold && millis > 0) win_->AttrOn(A_BOLD), resetBold = true;
+					win_->PrintF("%03d", millis);
 				}
 				else
-					win_->PrintF(i, margin + 6, tsWidth - 6, "%s", entry->time.c_str());
+					win_->PrintF(i, margin + 6, tsWidth - 6, "%s", TimeText(entry.time).c_str());
 				win_->AttrOff(COLOR_PAIR(LM_TIMESTAMP));
-				lastTimestamp = ts;
+				lastSecond = second;
 				if (resetBold)
 					win_->AttrOff(A_BOLD);
 			}
@@ -207,22 +225,22 @@ void LogView::Render()
 			if (col_ > 0)
 				win_->MvAddch(i, margin + tsWidth - 1, ACS_VLINE);
 
-			if (col_ < (int)entry->body.size())
-				RenderBody(i, tsWidth + margin, bodyWidth, entry->body.c_str(), col_);
+			if (col_ < (int)entry.body.size())
+				RenderBody(i, tsWidth + margin, bodyWidth, entry.body.c_str(), col_);
 			else
 				win_->PrintF(i, tsWidth + margin, bodyWidth, "");
 			lastNoneEmptyLine = i;
 
 			// draw line markers
 			// thread the tid's, we always draw the current line 
-			if (tid == entry->tid && tid != 0) {
+			if (tid == entry.tid && tid != 0) {
 				if (tidCtr++ == 1) {
 					// we have the same tid as the previous line, and the previous line was the first one
 					win_->MvAddch(i - 1, 1, lastMarker = ACS_ULCORNER);
 				}
 				win_->MvAddch(i , 1, lastMarker = ACS_VLINE);
 			}
-			else if (tid != entry->tid && entry->tid != 0) {
+			else if (tid != entry.tid && entry.tid != 0) {
 				// we have a new tid and the previous one wasn't unknown
 				if (tid != 0) {
 					if (tidCtr == 1)
@@ -232,10 +250,10 @@ void LogView::Render()
 				}
 				// start accumulating again
 				tidCtr = 1;
-				tid = entry->tid;
+				tid = entry.tid;
 				win_->MvAddch(i, 1, lastMarker = ACS_ULCORNER);
 			}
-			else if (tid != 0 && entry->tid == 0) {
+			else if (tid != 0 && entry.tid == 0) {
 				// this line doesn't have tid, consider it as part of the previous tid
 				tidCtr++;
 				win_->MvAddch(i, 1, lastMarker = ACS_VLINE);
@@ -313,6 +331,16 @@ void LogView::SetPosition()
 
 
 	ui_->SetStatus(0, 0, "");
-	ui_->SetStatus(1, LM_STATUS_BAR, "  %-s", file_->Filename().string().c_str());
+	const auto& stats = file_->GetStats();
+	const double MB = 1024.0 * 1024.0;
+	int rotations = stats.rotations.load(std::memory_order_relaxed);
+	int truncations = stats.truncations.load(std::memory_order_relaxed);
+	const char* spill = stats.spillFailed.load(std::memory_order_relaxed) ? ", spill to disk failed" : "";
+	if (rotations > 0 || truncations > 0)
+		ui_->SetStatus(1, LM_STATUS_BAR, "  %-s  (%d lines, %.1f of %.1f MB, rotated %d, truncated %d%s)", file_->Filename().string().c_str(),
+			file_->NumLines(), file_->BufferBytes() / MB, file_->GetBudget() / MB, rotations, truncations, spill);
+	else
+		ui_->SetStatus(1, LM_STATUS_BAR, "  %-s  (%d lines, %.1f of %.1f MB%s)", file_->Filename().string().c_str(),
+			file_->NumLines(), file_->BufferBytes() / MB, file_->GetBudget() / MB, spill);
 	ui_->SetStatus(2, tail_ ? LM_STATUS_TAIL : LM_STATUS_PAUSED, " [%s] %s", tail_ ? "Tail" : "Paused", !tail_ ? " press enter to continue " : "");
 }
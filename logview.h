@@ -26,6 +26,7 @@ public:
 	virtual void Resize();
 	virtual void Render();
 	virtual void SetSearchPattern(const std::string& searchPattern);
+	virtual bool GotoTime(int time);
 	void SetPosition();
 
 private:
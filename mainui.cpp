@@ -7,9 +7,12 @@
 #include "inputtext.h"
 #include "utils.h"
 #include "messageview.h"
+#include "stuckview.h"
 
-MainUi::MainUi()
+MainUi::MainUi(const BackfillOptions& backfill, size_t memoryBudget, bool indexFiles, const MessageLimits& messageLimits)
+	: backfill_(backfill), indexFiles_(indexFiles), messageLimits_(messageLimits)
 {
+	logTailer_.SetBudget(memoryBudget);
 }
 
 void MainUi::SetColorScheme(int idx)
@@ -32,9 +35,9 @@ MainUi::~MainUi()
 
 void MainUi::AddLog(std::shared_ptr<LogFile> logfile, const char* title)
 {
-	if (logfiles_.size() > 9)
-		throw std::runtime_error("Exceeded number of supported log files");
 	logfiles_.push_back(logfile);
+	logfile->SetBackfill(backfill_);
+	logfile->SetIndexed(indexFiles_);
 	logTailer_.AddLogFile(logfile);
 	// create the log view
 	int maxy, maxx;
@@ -94,7 +97,7 @@ void MainUi::CreateHelpView()
 	views_.push_back(helpView_);
 }
 
-void MainUi::CreateMessageView(MessageCollectorPtr msgCollector)
+void MainUi::CreateMessageView(MessageCollectorPtr msgCollector, MessageFeedPtr msgFeed)
 {
 	int maxy, maxx;
 	getmaxyx(curscr, maxy, maxx);
@@ -103,13 +106,23 @@ void MainUi::CreateMessageView(MessageCollectorPtr msgCollector)
 		// this could also easiliy mean that I don't understand ncurses enough  
 		//win_->MakeSubWindow(120, 100, 0, 0),
 		std::make_shared<Window>(newwin(maxy - 4, maxx, 2, 0)),
-		msgCollector);
+		msgCollector, msgFeed);
 	ViewPtr logView(view);
 	logView->SetTitle("Messages");
 	hotKeyViews_.push_back(logView);
 	views_.push_back(logView);
 }
 
+void MainUi::CreateStuckView(MessageCollectorPtr msgCollector)
+{
+	int maxy, maxx;
+	getmaxyx(curscr, maxy, maxx);
+	ViewPtr view(new StuckView(this, std::make_shared<Window>(newwin(maxy - 4, maxx, 2, 0)), msgCollector));
+	view->SetTitle("Stuck");
+	hotKeyViews_.push_back(view);
+	views_.push_back(view);
+}
+
 void MainUi::Init()
 {
 	initscr();
@@ -152,13 +165,17 @@ void MainUi::Init()
 	AddLog(std::make_shared<LogFile>(controllerLogging, "MMPop3"), "Pop3");
 	AddLog(std::make_shared<LogFile>(cfgSvcLogging, "segcfgapi", true), "Cfg Service");
 
-	auto msgCollector = std::make_shared<MessageCollector>();
-	msgCollector->AddLogFile(MessageCollector::LogType::receiver, rxLog);
-	msgCollector->AddLogFile(MessageCollector::LogType::engine, engLog);
-	msgCollector->AddLogFile(MessageCollector::LogType::sender, txLog);
+	auto msgCollector = std::make_shared<MessageCollector>(messageLimits_);
+	auto msgFeed = std::make_shared<MessageFeed>(msgCollector);
+	msgFeed->AddLogFile(MessageCollector::LogType::receiver, rxLog);
+	msgFeed->AddLogFile(MessageCollector::LogType::engine, engLog);
+	msgFeed->AddLogFile(MessageCollector::LogType::sender, txLog);
+	msgCollector_ = msgCollector;
+	msgFeed_ = msgFeed;
 
 	CreateConsolidatedView();
-	CreateMessageView(msgCollector);
+	CreateMessageView(msgCollector, msgFeed);
+	CreateStuckView(msgCollector);
 	CreateHelpView();
 
 	if (!activeView_)
@@ -222,6 +239,9 @@ void MainUi::Run()
 
 	logTailer_.Run();
 	Dispatch();
+	// the feed's threads are stopped while the logs they're subscribed to are still around
+	if (msgFeed_)
+		msgFeed_->Stop();
 	logTailer_.Shutdown();
 	endwin();
 }
@@ -232,8 +252,12 @@ void MainUi::Dispatch()
 	terminate_ = false;
 	clock_t lastRender = 0;
 	while (!terminate_) {
-		std::this_thread::sleep_for(20ms);
-		if (!Update() && lastRender + CLOCKS_PER_SEC > clock())
+		// wake up as soon as new lines are read so they're on screen straight away,
+		// otherwise poll the keyboard every 20ms
+		bool updated = WaitForSingleObject(logTailer_.GetUpdateEvent(), 20) == WAIT_OBJECT_0;
+		if (msgCollector_)
+			msgCollector_->CheckDeadlines();
+		if (!Update() && !updated && lastRender + CLOCKS_PER_SEC > clock())
 			continue;
 		Render();
 		win_->Refresh();
@@ -259,6 +283,27 @@ void MainUi::DoSearch()
 		activeView->SetSearchPattern(inputText.GetText());
 }
 
+void MainUi::DoGotoTime()
+{
+	InputText inputText(win_, win_->GetMaxY() - 1, 0, " Go to time (HH:MM[:SS[.mmm]]): ");
+
+	statusLine_->SetVisible(false);
+	int res;
+	while ((res = inputText.GetInput()) == 0) {
+		Render();
+		inputText.Render();
+	}
+	statusLine_->SetVisible(true);
+	if (res != 1)
+		return;
+
+	int hours = 0, minutes = 0, seconds = 0, millis = 0;
+	int fields = sscanf(inputText.GetText().c_str(), "%d:%d:%d.%d", &hours, &minutes, &seconds, &millis);
+	if (fields < 2 || hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59 || millis < 0 || millis > 999)
+		return;
+	GetActiveView()->GotoTime(((hours * 60 + minutes) * 60 + seconds) * 1000 + millis);
+}
+
 bool MainUi::Update()
 {
 	int c = getch();
@@ -308,6 +353,22 @@ bool MainUi::Update()
 	case '/':
 		DoSearch();
 		return true;
+
+	case ':':
+		DoGotoTime();
+		return true;
+
+	case '\t': case KEY_BTAB:
+	{
+		// there can be more views than number keys, tab goes through all of them
+		auto it = std::find(hotKeyViews_.begin(), hotKeyViews_.end(), activeView_);
+		if (it == hotKeyViews_.end() || hotKeyViews_.empty())
+			return false;
+		size_t idx = it - hotKeyViews_.begin();
+		idx = (idx + (c == KEY_BTAB ? hotKeyViews_.size() - 1 : 1)) % hotKeyViews_.size();
+		activeView_ = hotKeyViews_[idx];
+		return true;
+	}
 	}
 
 	if (c >= '1' && c <= '9') {
@@ -344,9 +405,15 @@ void MainUi::RenderMenu()
 			win_->AttrOn(COLOR_PAIR(LM_ACTIVE));
 			win_->AttrOn(A_BOLD);
 		}
-		idx++;
-		win_->PrintF(0, x, (int)view->Title().size() + 5, "%d. %s", idx, view->Title().c_str());
-		x += (int)view->Title().size() + 4;
+		// only the first nine have a number key
+		if (++idx <= 9) {
+			win_->PrintF(0, x, (int)view->Title().size() + 5, "%d. %s", idx, view->Title().c_str());
+			x += (int)view->Title().size() + 4;
+		}
+		else {
+			win_->PrintF(0, x, (int)view->Title().size() + 2, "%s", view->Title().c_str());
+			x += (int)view->Title().size() + 1;
+		}
 		if (view == activeView_) {
 			win_->AttrOff(A_BOLD);
 			win_->AttrOff(COLOR_PAIR(LM_ACTIVE));
@@ -354,6 +421,27 @@ void MainUi::RenderMenu()
 		win_->PrintF(0, x, 3, " | ");
 		x += 3;
 	}
+	RenderFlow(x);
+}
+
+// the messages going through MailMarshal, on the right of the menu bar
+void MainUi::RenderFlow(int x)
+{
+	if (!msgCollector_)
+		return;
+	auto flow = msgCollector_->GetFlow();
+	size_t stuck = msgCollector_->NumStuck();
+	char text[192];
+	int length = snprintf(text, sizeof(text), "rx %.1f/s eng %.1f/s tx %.1f/s (hour %.1f/%.1f/%.1f)  awaiting engine %lld  in engine %lld  stuck %d",
+		flow.rate[MessageFlow::received], flow.rate[MessageFlow::engine], flow.rate[MessageFlow::sent],
+		flow.hourRate[MessageFlow::received], flow.hourRate[MessageFlow::engine], flow.hourRate[MessageFlow::sent],
+		(long long)flow.awaitingEngine, (long long)flow.inEngine, (int)stuck);
+
+	int maxx = win_->GetMaxX();
+	win_->Move(0, x);
+	win_->ClearToEol();
+	if (x + length + 2 <= maxx)
+		win_->PrintF(0, maxx - length - 1, length + 1, "%s", text);
 }
 
 void MainUi::SetStatus(int section, chtype color, const char* fmt, ...)
@@ -6,6 +6,7 @@
 #include "view.h"
 #include "panel.h"
 #include "messagecollector.h"
+#include "messagefeed.h"
 
 #define LM_STATUS_BAR 1
 #define LM_TIMESTAMP 2
@@ -108,7 +109,8 @@ public:
 class MainUi
 {
 public:
-	MainUi();
+	MainUi(const BackfillOptions& backfill = BackfillOptions(), size_t memoryBudget = LogTailer::DefaultBudget, bool indexFiles = false,
+		const MessageLimits& messageLimits = MessageLimits());
 	~MainUi();
 	void AddLog(std::shared_ptr<LogFile> logfile, const char* title);
 	void Run();
@@ -123,7 +125,12 @@ private:
 	std::string status_;
 	bool terminate_;
 	LogTailer logTailer_;
+	BackfillOptions backfill_;
+	bool indexFiles_;
+	MessageLimits messageLimits_;
 	std::shared_ptr<StatusLine> statusLine_;
+	MessageCollectorPtr msgCollector_;
+	MessageFeedPtr msgFeed_;
 
 	// our views
 	std::vector<ViewPtr> views_;
@@ -139,13 +146,16 @@ private:
 	void Init();
 	void InitColorSchemes();
 	void CreateConsolidatedView();
-	void CreateMessageView(MessageCollectorPtr msgCollector);
+	void CreateMessageView(MessageCollectorPtr msgCollector, MessageFeedPtr msgFeed);
+	void CreateStuckView(MessageCollectorPtr msgCollector);
 	void CreateHelpView();
 	void SetColorScheme(int idx);
 	void Dispatch();
 	bool Update();
 	void Render();
 	void RenderMenu();
+	void RenderFlow(int x);
 	void RenderStatusLine();
 	void DoSearch();
+	void DoGotoTime();
 };
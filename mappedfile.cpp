@@ -0,0 +1,98 @@
+#include "mappedfile.h"
+
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFn)(HANDLE, ULONG_PTR, WIN32_MEMORY_RANGE_ENTRY*, ULONG);
+
+// PrefetchVirtualMemory is only there from Windows 8, without it the pages are
+// faulted in as they're parsed and the sequential scan hint does the read ahead
+static PrefetchVirtualMemoryFn GetPrefetch()
+{
+	static PrefetchVirtualMemoryFn prefetch = reinterpret_cast<PrefetchVirtualMemoryFn>(
+		GetProcAddress(GetModuleHandle("kernel32.dll"), "PrefetchVirtualMemory"));
+	return prefetch;
+}
+
+static DWORD GetGranularity()
+{
+	static DWORD granularity = []() {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwAllocationGranularity;
+	}();
+	return granularity;
+}
+
+bool MappedFile::Open(const fs::path& path)
+{
+	Close();
+	// share delete as well so the log can still be rotated while we read it
+	file_ = CreateFile(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+		// an empty file can't be mapped, but there's nothing to read either
+		Close();
+		return false;
+	}
+	size_ = size.QuadPart;
+	mapping_ = CreateFileMapping(file_, nullptr, PAGE_READONLY, (DWORD)(size_ >> 32), (DWORD)size_, nullptr);
+	if (mapping_ == nullptr) {
+		DLog("CreateFileMapping failed for %s, err=%d\n", path.string().c_str(), (int)GetLastError());
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	Unmap();
+	if (mapping_) {
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+	}
+	if (file_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+	size_ = 0;
+}
+
+void MappedFile::Unmap()
+{
+	if (view_)
+		UnmapViewOfFile(view_);
+	view_ = nullptr;
+	data_ = nullptr;
+	length_ = 0;
+}
+
+bool MappedFile::Map(int64_t offset, size_t length)
+{
+	Unmap();
+	if (mapping_ == nullptr || offset < 0 || offset >= size_)
+		return false;
+	length = (size_t)std::min<int64_t>(length, size_ - offset);
+
+	// views have to start on an allocation boundary
+	int64_t start = offset - offset % GetGranularity();
+	size_t viewLength = (size_t)(offset - start) + length;
+	view_ = MapViewOfFile(mapping_, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, viewLength);
+	if (view_ == nullptr) {
+		DLog("MapViewOfFile failed at %lld, err=%d\n", (long long)start, (int)GetLastError());
+		return false;
+	}
+	data_ = static_cast<const char*>(view_) + (offset - start);
+	length_ = length;
+
+	auto prefetch = GetPrefetch();
+	if (prefetch) {
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = view_;
+		range.NumberOfBytes = viewLength;
+		prefetch(GetCurrentProcess(), 1, &range, 0);
+	}
+	return true;
+}
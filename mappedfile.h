@@ -0,0 +1,37 @@
+#pragma once
+
+#include "utils.h"
+
+// A read only view of part of a file, for reading history where there's no need
+// to go through stdio. The file is opened for sequential access and each view is
+// prefetched, so the pages are read ahead of the parser and lines can be parsed
+// in place without being copied first.
+class MappedFile
+{
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+	int64_t size_ = 0;
+	void* view_ = nullptr;			// start of the view, aligned to the allocation granularity
+	const char* data_ = nullptr;	// the offset that was asked for within the view
+	size_t length_ = 0;
+
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// the size is fixed when the file is opened, anything written after that isn't mapped
+	bool Open(const fs::path& path);
+	void Close();
+	int64_t Size() const { return size_; }
+
+	// maps [offset, offset + length) clipped to the size, replacing the previous view
+	bool Map(int64_t offset, size_t length);
+	const char* Data() const { return data_; }
+	size_t Length() const { return length_; }
+
+private:
+	void Unmap();
+};
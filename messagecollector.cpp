@@ -1,152 +1,689 @@
-#include "MessageCollector.h"
+#include "messagecollector.h"
+#include "messagescanner.h"
+#include "dlog.h"
+#include "spinlock.h"
+#include <algorithm>
+#ifdef _DEBUG
+#include <boost/regex.hpp>
+#include <cassert>
+#endif
 
-MessageCollector::MessageCollector()
+MessageCollector::MessageCollector(const MessageLimits& limits)
+	: generation_(0)
 {
+	SetLimits(limits);
+}
 
+MessageCollector::Shard& MessageCollector::ShardOf(uint64_t msgId) const
+{
+	// the top bits, the shard's map uses the low ones of its own hash
+	return shards_[(msgId * 0x9e3779b97f4a7c15ull) >> 60];
 }
 
-const void MessageCollector::FillBuffer(std::vector<MessageInfoPtr>& buf) const
+MessageInfoPtr MessageCollector::CopyOf(Entry& entry)
 {
-	{
-		Spinlock lock(lock_);
-		buf.clear();
-		for (auto it : messages_)
-			buf.push_back(it.second);
+	if (!entry.copy)
+		entry.copy = std::make_shared<const MessageInfo>(entry.info);
+	return entry.copy;
+}
+
+const MessageInfoPtr& MessageList::operator[](size_t idx) const
+{
+	// down the tree to the slot with idx messages before it
+	size_t n = tree_.size() - 1;
+	size_t step = 1;
+	while (step * 2 <= n)
+		step *= 2;
+	size_t pos = 0;
+	size_t remaining = idx + 1;
+	for (; step > 0; step /= 2) {
+		if (pos + step <= n && tree_[pos + step] < remaining) {
+			pos += step;
+			remaining -= tree_[pos];
+		}
 	}
-	std::sort(buf.begin(), buf.end(), [](const auto& lhs, const auto& rhs) {
-		return lhs->touchTime < rhs->touchTime;
-	});
+	return slots_[pos];
+}
+
+void MessageList::Clear(size_t numShards)
+{
+	slots_.clear();
+	tree_.assign(1, 0);
+	where_ = FlatMap<size_t>();
+	shards_.assign(numShards, Shard());
+	size_ = 0;
+}
+
+void MessageList::Append(size_t shard, MessageInfoPtr info)
+{
+	size_t slot = slots_.size();
+	where_[info->messageId] = slot;
+	shards_[shard].order.push_back(slot);
+	shards_[shard].count++;
+	slots_.push_back(std::move(info));
+	size_++;
+
+	// the new node counts the slots after k less its lowest bit up to k
+	size_t k = slot + 1;
+	uint32_t count = 1;
+	for (size_t j = k - 1; j > k - (k & (0 - k)); j -= j & (0 - j))
+		count += tree_[j];
+	tree_.push_back(count);
+}
+
+void MessageList::Remove(size_t shard, size_t slot)
+{
+	// a message that expired and came back has its new copy in by now
+	auto& info = slots_[slot];
+	auto found = where_.Find(info->messageId);
+	if (found != nullptr && *found == slot)
+		where_.Erase(info->messageId);
+	info.reset();
+	for (size_t k = slot + 1; k < tree_.size(); k += k & (0 - k))
+		tree_[k]--;
+	shards_[shard].count--;
+	size_--;
+}
+
+// the shard's oldest messages that aren't in keep
+void MessageList::Expire(size_t shard, size_t count, const FlatMap<bool>& keep)
+{
+	auto& order = shards_[shard].order;
+	std::vector<size_t> kept;
+	while (count > 0 && !order.empty()) {
+		size_t slot = order.front();
+		order.pop_front();
+		if (!slots_[slot])
+			continue;
+		if (keep.Find(slots_[slot]->messageId) != nullptr) {
+			kept.push_back(slot);
+			continue;
+		}
+		Remove(shard, slot);
+		count--;
+	}
+	order.insert(order.begin(), kept.begin(), kept.end());
+}
+
+// closes up the holes once there are as many as there are messages, so each
+// message taken out pays for moving about one other
+void MessageList::Compact()
+{
+	size_t holes = slots_.size() - size_;
+	if (holes < 64 || holes < size_)
+		return;
+
+	const size_t Gone = ~(size_t)0;
+	std::vector<size_t> moved(slots_.size(), Gone);
+	size_t n = 0;
+	for (size_t i = 0; i < slots_.size(); i++) {
+		if (!slots_[i])
+			continue;
+		moved[i] = n;
+		where_[slots_[i]->messageId] = n;
+		slots_[n++] = std::move(slots_[i]);
+	}
+	slots_.resize(n);
+	for (auto& shard : shards_) {
+		std::deque<size_t> order;
+		for (auto slot : shard.order) {
+			if (moved[slot] != Gone)
+				order.push_back(moved[slot]);
+		}
+		shard.order.swap(order);
+	}
+	tree_.assign(n + 1, 1);
+	tree_[0] = 0;
+	for (size_t k = 1; k <= n; k++) {
+		size_t parent = k + (k & (0 - k));
+		if (parent <= n)
+			tree_[parent] += tree_[k];
+	}
+}
+
+bool MessageCollector::FillBuffer(MessageList& list) const
+{
+	static_assert(NumShards == 16, "ShardOf takes the top 4 bits");
+
+	// only the changes up to here are taken, so everything taken sorts after what the
+	// list already has and can go on the end, any after it are left for the next call
+	uint64_t limit = generation_.load();
+
+	std::vector<MessageInfoPtr> changed;
+	FlatMap<bool> keep;				// moved since the limit, the list keeps its copy for now
+	bool rebuild = list.shards_.size() != NumShards;
+	bool any = rebuild;
+
+	for (size_t i = 0; i < NumShards && !rebuild; i++) {
+		auto& shard = shards_[i];
+		auto& position = list.shards_[i];
+		Spinlock lock(shard.lock);
+		if (position.generation == std::min(limit, shard.generation) && position.expired == shard.expired)
+			continue;
+		any = true;
+
+		// The messages that expired since are the oldest ones the list has from the shard
+		// that haven't moved since, unless so many went that some it never had went too,
+		// and then every message it has from the shard is gone or has moved
+		size_t expired = (size_t)(shard.expired - position.expired);
+		size_t count = position.count;
+		size_t moved = 0;
+		for (auto entry = shard.newest; entry != nullptr && entry->info.generation > position.generation; entry = entry->older) {
+			auto slot = entry->created <= position.generation ? list.where_.Find(entry->info.messageId) : nullptr;
+			if (slot != nullptr)
+				moved++;
+			if (entry->info.generation > limit) {
+				if (slot != nullptr)
+					keep[entry->info.messageId] = true;
+				continue;
+			}
+			if (slot != nullptr)
+				list.Remove(i, *slot);
+			changed.push_back(CopyOf(*entry));
+		}
+		if (expired > 0 && expired + moved >= count)
+			rebuild = true;
+		else if (expired > 0)
+			list.Expire(i, expired, keep);
+
+		position.generation = std::min(limit, shard.generation);
+		position.expired = shard.expired;
+	}
+	if (!any)
+		return false;
+
+	auto byGeneration = [](const MessageInfoPtr& lhs, const MessageInfoPtr& rhs) { return lhs->generation < rhs->generation; };
+	if (rebuild) {
+		// each shard is already in order, they just need merging
+		changed.clear();
+		list.Clear(NumShards);
+		for (size_t i = 0; i < NumShards; i++) {
+			auto& shard = shards_[i];
+			auto& position = list.shards_[i];
+			size_t merged = changed.size();
+			{
+				Spinlock lock(shard.lock);
+				for (auto entry = shard.oldest; entry != nullptr && entry->info.generation <= limit; entry = entry->newer)
+					changed.push_back(CopyOf(*entry));
+				position.generation = std::min(limit, shard.generation);
+				position.expired = shard.expired;
+			}
+			std::inplace_merge(changed.begin(), changed.begin() + merged, changed.end(), byGeneration);
+		}
+	}
+	else {
+		std::sort(changed.begin(), changed.end(), byGeneration);
+	}
+	for (auto& info : changed) {
+		size_t shard = &ShardOf(info->messageId) - shards_;
+		list.Append(shard, std::move(info));
+	}
+	list.Compact();
+	return true;
+}
+
+void MessageCollector::SetLimits(const MessageLimits& limits)
+{
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		shard.maxMessages = std::max<size_t>(1, limits.maxMessages / NumShards);
+		shard.maxBytes = limits.maxBytes / NumShards;
+		shard.engineDeadline = limits.engineDeadline;
+		shard.sendDeadline = limits.sendDeadline;
+		Expire(shard);
+	}
+}
+
+size_t MessageCollector::NumMessages() const
+{
+	size_t count = 0;
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		count += shard.messages.size();
+	}
+	return count;
 }
 
-void MessageCollector::AddLogFile(LogType logType, LogFilePtr logFile)
+size_t MessageCollector::MemoryUsed() const
 {
-	auto collector = shared_from_this();
-	switch (logType)
+	size_t bytes = 0;
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		bytes += shard.bytes;
+	}
+	return bytes;
+}
+
+void MessageCollector::Parse(LogType logType, const LogEntrySpan& entries)
+{
+	for (const auto& entry : entries) {
+		switch (logType) {
+		case LogType::receiver:
+			ParseReceiverLog(entry);
+			break;
+		case LogType::engine:
+			ParseEngineLog(entry);
+			break;
+		case LogType::sender:
+			ParseSenderLog(entry);
+			break;
+		}
+	}
+}
+
+// roughly what a copy of an entry takes up, the entry and its strings and the shared_ptr's count
+static size_t EntryBytes(const LogEntry& entry)
+{
+	return sizeof(LogEntry) + 2 * sizeof(long) + entry.body.capacity() + entry.severity.capacity() + entry.id.capacity();
+}
+
+// adds a copy of a log line to one of the message's logs, returns the change in the bytes they take up
+static ptrdiff_t AddLog(boost::circular_buffer<LogEntryPtr>& logs, LogEntryPtr entry)
+{
+	ptrdiff_t added = (ptrdiff_t)EntryBytes(*entry);
+	if (logs.full())
+		added -= (ptrdiff_t)EntryBytes(*logs.front());
+	logs.push_back(std::move(entry));
+	return added;
+}
+
+template <typename F>
+void MessageCollector::Update(uint64_t msgId, const LogEntry& line, F&& update)
+{
+	Sample latency[LatencyStats::NumStages];
+	Sample previous[LatencyStats::NumStages];
+	int measured = 0;
+	int reached;
+	int from, to;
 	{
-	case LogType::receiver:
-		logFile->GetSignal().connect([collector](LogFilePtr file, LogEntryPtr entry) {
-			collector->ParseReceiverLog(file, entry);
-			});
-		break;
+		auto& shard = ShardOf(msgId);
+		Spinlock lock(shard.lock);
+		auto& slot = shard.messages[msgId];
+		if (!slot) {
+			slot.reset(new Entry());
+			slot->info.messageId = msgId;
+			slot->deadline.key = msgId;
+			slot->bytes = sizeof(Entry) + 3 * 10 * sizeof(LogEntryPtr);
+			shard.bytes += slot->bytes;
+		}
+		auto entry = slot.get();
+		int engTimeLatest = entry->info.engTimeLatest;
+
+		entry->info.touchTime = time(nullptr);
+		ptrdiff_t added = update(entry->info);
+		entry->bytes += added;
+		shard.bytes += added;
+		entry->copy.reset();
+		Touch(shard, entry);
+		if (entry->created == 0)
+			entry->created = entry->info.generation;
+		if (line.time >= 0) {
+			measured = Measure(*entry, line, previous);
+			std::copy(std::begin(entry->measured), std::end(entry->measured), std::begin(latency));
+		}
+		from = entry->stage;
+		reached = Reach(*entry);
+		to = entry->stage;
+		if (line.time >= 0) {
+			int64_t second = LogClock::Second(line.day, line.time);
+			clock_.Observe(second);
+			Watch(shard, *entry, reached, entry->info.engTimeLatest != engTimeLatest, second);
+		}
+		Expire(shard);
+	}
 
-	case LogType::engine:
-		logFile->GetSignal().connect([collector](LogFilePtr file, LogEntryPtr entry) {
-			collector->ParseEngineLog(file, entry);
-			});
-		break;
+	if (to != from)
+		flow_.Move(from, to);
 
-	case LogType::sender:
-		logFile->GetSignal().connect([collector](LogFilePtr file, LogEntryPtr entry) {
-			collector->ParseSenderLog(file, entry);
-			});
-		break;
+	// a stage is counted in the minute of the line that finished it, and stays there if it changes
+	if (line.time < 0)
+		return;
+	for (int i = 0; i < LatencyStats::NumStages; i++) {
+		if ((measured & 1 << i) == 0)
+			continue;
+		const auto& sample = latency[i];
+		if (previous[i].ms < 0)
+			latency_.Record((LatencyStats::Stage)i, sample.day, sample.time, sample.ms);
+		else
+			latency_.Replace((LatencyStats::Stage)i, sample.day, sample.time, previous[i].ms, sample.ms);
+	}
+	for (int i = 0; i < MessageFlow::NumStages; i++) {
+		if ((reached & 1 << i) != 0)
+			flow_.Enter((MessageFlow::Stage)i, line.day, line.time);
 	}
 }
 
-MessageInfoPtr MessageCollector::CreateMessageInfo(const std::string msgName)
+// the stages the message has been seen at for the first time since it was last looked at
+int MessageCollector::Reach(Entry& entry)
 {
-	Spinlock lock(lock_);
-	auto it = messages_.find(msgName);
-	if (it != messages_.end()) {
-		it->second->touchTime = time(nullptr);
-		return it->second;
+	const auto& info = entry.info;
+	int seen = 0;
+	if (info.rxTime >= 0)
+		seen |= 1 << MessageFlow::received;
+	if (info.engTimeFirst >= 0)
+		seen |= 1 << MessageFlow::engine;
+	if (info.txTimeFirst >= 0)
+		seen |= 1 << MessageFlow::sent;
+
+	int reached = seen & ~entry.reached;
+	entry.reached |= reached;
+	for (int i = MessageFlow::NumStages - 1; i > entry.stage; i--) {
+		if ((entry.reached & 1 << i) != 0) {
+			entry.stage = i;
+			break;
+		}
 	}
+	return reached;
+}
 
-#ifdef _DEBUG
-	const int Threshold = 10;
-	const int EntriesToRemove = 3;
-#else
-	const int Threshold = 5000;
-	const int EntriesToRemove = 500;
-#endif
+MessageFlow::Figures MessageCollector::GetFlow() const
+{
+	return flow_.GetFigures();
+}
+
+// Keeps the deadline for the message's next stage, second is when the line that
+// got here was logged. Whatever stage a line shows, it moves the shard's wheel on
+// to it, so a backfill can mark messages stuck until the lines for their next stage
+// are read, they come off again as soon as they are.
+void MessageCollector::Watch(Shard& shard, Entry& entry, int reached, bool engine, int64_t second)
+{
+	Advance(shard, second);
+	if ((entry.reached & 1 << MessageFlow::sent) != 0) {
+		shard.deadlines.Cancel(entry.deadline);
+		shard.stuck.Erase(entry.info.messageId);
+		entry.waiting = -1;
+	}
+	else if (engine) {
+		// the engine may look at it more than once, the deadline runs from the last time
+		Schedule(shard, entry, MessageFlow::sent, second + shard.sendDeadline);
+	}
+	else if ((reached & 1 << MessageFlow::received) != 0 && (entry.reached & 1 << MessageFlow::engine) == 0) {
+		Schedule(shard, entry, MessageFlow::engine, second + shard.engineDeadline);
+	}
+}
 
-	if (messages_.size() > Threshold) {
-		DLog("Expiring entries out of the message collector\n");
-		std::vector<MessageInfoPtr> sorted;
-		for (auto tmp : messages_) 
-			sorted.push_back(tmp.second);
+void MessageCollector::Schedule(Shard& shard, Entry& entry, MessageFlow::Stage waiting, int64_t expires)
+{
+	entry.waiting = waiting;
+	shard.stuck.Erase(entry.info.messageId);
+	shard.deadlines.Schedule(entry.deadline, expires);
+}
+
+void MessageCollector::Advance(Shard& shard, int64_t second)
+{
+	shard.deadlines.Advance(second, [&](WheelTimer& timer) {
+		auto slot = shard.messages.Find(timer.key);
+		if (slot != nullptr)
+			shard.stuck[timer.key] = slot->get();
+	});
+}
 
-		std::sort(sorted.begin(), sorted.end(), 
-			[](const MessageInfoPtr& lhs, const MessageInfoPtr& rhs) { 
-				return lhs->touchTime < rhs->touchTime; });
-		for (int i = 0; i < EntriesToRemove; i++) 
-			messages_.erase(messages_.find(sorted[i]->messageName));
-		DLog("Removed %d entries from message collector\n", EntriesToRemove);
+// while the logs are quiet the wheels carry on from the latest line by the time
+// passing here, which is what lets a message with no more lines become stuck
+void MessageCollector::CheckDeadlines()
+{
+	int64_t now = clock_.Now();
+	if (now < 0)
+		return;
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		Advance(shard, now);
 	}
+}
 
-	auto ptr = std::make_shared<MessageInfo>();
-	ptr->touchTime = time(nullptr);
-	ptr->messageName = msgName;
-	messages_[msgName] = ptr;
-	return ptr;
+size_t MessageCollector::NumStuck() const
+{
+	size_t count = 0;
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		count += shard.stuck.size();
+	}
+	return count;
 }
 
-void MessageCollector::ParseReceiverLog(LogFilePtr file, LogEntryPtr entry)
+void MessageCollector::GetStuck(std::vector<StuckMessage>& stuck) const
 {
-	if (entry->type != MessageType::normal)
+	stuck.clear();
+	for (auto& shard : shards_) {
+		Spinlock lock(shard.lock);
+		int64_t now = shard.deadlines.Now();
+		shard.stuck.ForEach([&](uint64_t, Entry* entry) {
+			StuckMessage message;
+			message.info = CopyOf(*entry);
+			message.waiting = (MessageFlow::Stage)entry->waiting;
+			message.overdue = now - entry->deadline.expires;
+			stuck.push_back(std::move(message));
+		});
+	}
+}
+
+// milliseconds from one time of day to a later one, which may be after midnight
+static int Elapsed(int from, int to)
+{
+	const int Day = 24 * 60 * 60 * 1000;
+	int ms = to - from;
+	if (ms < -Day / 2)
+		ms += Day;
+	return ms;
+}
+
+// The stages of the message whose latency is new or has changed with line, previous
+// gets what was recorded for them before. A message has reached the engine once it's
+// seen there, and has left it once it's seen in the sender. The logs are parsed on
+// their own threads so the lines can turn up in any order: each stage is measured
+// once both its ends are there, and an engine line that's read after the sender's
+// moves the end of the engine's stages, so they're measured again.
+int MessageCollector::Measure(Entry& entry, const LogEntry& line, Sample (&previous)[LatencyStats::NumStages])
+{
+	const auto& info = entry.info;
+	int latency[LatencyStats::NumStages] = { -1, -1, -1 };
+	if (info.rxTime >= 0 && info.engTimeFirst >= 0)
+		latency[LatencyStats::receiveToEngine] = Elapsed(info.rxTime, info.engTimeFirst);
+	if (info.engTimeFirst >= 0 && info.txTimeFirst >= 0) {
+		latency[LatencyStats::engineProcessing] = Elapsed(info.engTimeFirst, info.engTimeLatest);
+		latency[LatencyStats::engineToSend] = Elapsed(info.engTimeLatest, info.txTimeFirst);
+	}
+
+	int changed = 0;
+	for (int i = 0; i < LatencyStats::NumStages; i++) {
+		// a negative one is lines from clocks that disagree, it's left until one that makes sense
+		auto& sample = entry.measured[i];
+		if (latency[i] < 0 || latency[i] == sample.ms)
+			continue;
+		previous[i] = sample;
+		if (sample.ms < 0) {
+			sample.day = line.day;
+			sample.time = line.time;
+		}
+		sample.ms = latency[i];
+		changed |= 1 << i;
+	}
+	return changed;
+}
+
+void MessageCollector::GetLatency(int minutes, LatencyStats::Figures (&figures)[LatencyStats::NumStages]) const
+{
+	latency_.GetFigures(minutes, figures);
+}
+
+void MessageCollector::Touch(Shard& shard, Entry* entry)
+{
+	// taken under the shard's lock so they're in order along its list
+	entry->info.generation = shard.generation = ++generation_;
+	if (shard.newest == entry)
 		return;
+	Unlink(shard, entry);
+	entry->older = shard.newest;
+	if (shard.newest != nullptr)
+		shard.newest->newer = entry;
+	shard.newest = entry;
+	if (shard.oldest == nullptr)
+		shard.oldest = entry;
+}
 
-	static boost::regex arrivePattern = boost::regex("^TX:\\s<250\\s(\\w+)\\sMessage\\saccepted\\sfor\\sdelivery>$");
-	static boost::regex msgPattern = boost::regex("([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml");
-	static boost::regex spamProfilerPattern = boost::regex("^([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml\\sSpamProfiler\\sscore:\\s(\\d+),\\srescan:\\s(\\d+),\\sbulk:\\s(\\d+)");
-	
-	boost::match_results<std::string::const_iterator> match;
-	if (boost::regex_search(entry->body, match, arrivePattern, boost::match_default)) {
-		assert(match.length() > 1);
-		auto msgName = std::string(match[1].begin(), match[1].end());
-		auto msgInfo = CreateMessageInfo(msgName);
-		msgInfo->rxTime = entry->time;
-		msgInfo->rxLogs.push_back(entry);
-	}
-	else if (boost::regex_search(entry->body, match, spamProfilerPattern, boost::match_default)) {
-		assert(match.length() > 5);
-		auto msgName = std::string(match[1].begin(), match[1].end());
-		auto score = std::string(match[2].begin(), match[2].end());
-		auto rescan = std::string(match[3].begin(), match[3].end());
-		auto bulk = std::string(match[4].begin(), match[4].end());
-		auto msgInfo = CreateMessageInfo(msgName);
-		msgInfo->spamProfilerScore = atoi(score.c_str());
-		msgInfo->spamProfilerRescan = atoi(rescan.c_str());
-		msgInfo->spamProfilerBulk = atoi(bulk.c_str());
-		msgInfo->rxLogs.push_back(entry);
-	}
-	else if (boost::regex_search(entry->body, match, msgPattern, boost::match_default)) {
-		assert(match.length() > 2);
-		auto msgName = std::string(match[1].begin(), match[1].end());
-		auto msgInfo = CreateMessageInfo(msgName);
-		msgInfo->rxLogs.push_back(entry);
-	}
-}
-
-void MessageCollector::ParseEngineLog(LogFilePtr file, LogEntryPtr entry)
+void MessageCollector::Unlink(Shard& shard, Entry* entry)
 {
-	static boost::regex msgPattern = boost::regex("([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml");
+	if (entry->newer != nullptr)
+		entry->newer->older = entry->older;
+	else if (shard.newest == entry)
+		shard.newest = entry->older;
+	if (entry->older != nullptr)
+		entry->older->newer = entry->newer;
+	else if (shard.oldest == entry)
+		shard.oldest = entry->newer;
+	entry->newer = entry->older = nullptr;
+}
 
-	boost::match_results<std::string::const_iterator> match;
-	if (boost::regex_search(entry->body, match, msgPattern, boost::match_default)) {
-		assert(match.length() > 1);
-		auto msgName = std::string(match[1].begin(), match[1].end());
-		auto msgInfo = CreateMessageInfo(msgName);
-		if (msgInfo->engTimeFirst.empty())
-			msgInfo->engTimeFirst = entry->time;
-		msgInfo->engTimeLatest = entry->time;
-		msgInfo->engLogs.push_back(entry);
+// drops the shard's oldest messages until it's back under its share of the limits,
+// the newest one always stays
+void MessageCollector::Expire(Shard& shard)
+{
+	size_t removed = 0;
+	while (shard.oldest != shard.newest && (shard.messages.size() > shard.maxMessages || shard.bytes > shard.maxBytes)) {
+		auto entry = shard.oldest;
+		Unlink(shard, entry);
+		shard.bytes -= entry->bytes;
+		shard.deadlines.Cancel(entry->deadline);
+		shard.stuck.Erase(entry->info.messageId);
+		if (entry->stage >= 0)
+			flow_.Forget(entry->stage);
+		shard.messages.Erase(entry->info.messageId);	// frees entry
+		removed++;
 	}
+	shard.expired += removed;
+	if (removed > 0)
+		DLog("Removed %d entries from message collector\n", (int)removed);
+}
+
+#ifdef _DEBUG
+// the patterns the scanner replaced, debug builds check it still agrees with them
 
+// the packed name of a matched message name, 0 if it isn't one
+static uint64_t MessageIdOf(const boost::ssub_match& match)
+{
+	return match.length() == MessageNameLength ? PackMessageId(&*match.first) : 0;
 }
 
-void MessageCollector::ParseSenderLog(LogFilePtr file, LogEntryPtr entry)
+// any line with a message file name in it
+static MessageLine MatchMessageLine(const std::string& body)
 {
 	static boost::regex msgPattern = boost::regex("([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml");
 
+	MessageLine line;
+	boost::match_results<std::string::const_iterator> match;
+	if (boost::regex_search(body, match, msgPattern, boost::match_default)) {
+		line.kind = MessageLine::Kind::mentioned;
+		line.messageId = MessageIdOf(match[1]);
+	}
+	return line;
+}
+
+static MessageLine MatchReceiverLine(const std::string& body)
+{
+	static boost::regex arrivePattern = boost::regex("^TX:\\s<250\\s(\\w+)\\sMessage\\saccepted\\sfor\\sdelivery>$");
+	static boost::regex spamProfilerPattern = boost::regex("^([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml\\sSpamProfiler\\sscore:\\s(\\d+),\\srescan:\\s(\\d+),\\sbulk:\\s(\\d+)");
+
+	MessageLine line;
 	boost::match_results<std::string::const_iterator> match;
-	if (boost::regex_search(entry->body, match, msgPattern, boost::match_default)) {
-		assert(match.length() > 1);
-		auto msgName = std::string(match[1].begin(), match[1].end());
-		auto msgInfo = CreateMessageInfo(msgName);
-		if (msgInfo->txTimeFirst.empty())
-			msgInfo->txTimeFirst = entry->time;
-		msgInfo->txTimeLatest = entry->time;
-		msgInfo->txLogs.push_back(entry);
+	if (boost::regex_search(body, match, arrivePattern, boost::match_default)) {
+		line.kind = MessageLine::Kind::arrived;
+		line.messageId = MessageIdOf(match[1]);
+	}
+	else if (boost::regex_search(body, match, spamProfilerPattern, boost::match_default)) {
+		line.kind = MessageLine::Kind::spamProfiler;
+		line.messageId = MessageIdOf(match[1]);
+		line.spamProfilerScore = atoi(std::string(match[2].begin(), match[2].end()).c_str());
+		line.spamProfilerRescan = atoi(std::string(match[3].begin(), match[3].end()).c_str());
+		line.spamProfilerBulk = atoi(std::string(match[4].begin(), match[4].end()).c_str());
+	}
+	else {
+		line = MatchMessageLine(body);
 	}
+	return line;
+}
+
+static void VerifyScan(const std::string& body, const MessageLine& line, bool receiver)
+{
+	auto expected = receiver ? MatchReceiverLine(body) : MatchMessageLine(body);
+	if (line.kind != expected.kind || line.messageId != expected.messageId || line.spamProfilerScore != expected.spamProfilerScore
+		|| line.spamProfilerRescan != expected.spamProfilerRescan || line.spamProfilerBulk != expected.spamProfilerBulk) {
+		DLog("Message scanner disagrees with the patterns on: %s\n", body.c_str());
+		assert(false);
+	}
+}
+#endif
+
+void MessageCollector::ParseReceiverLog(const LogEntry& entry)
+{
+	if (entry.type != MessageType::normal)
+		return;
+
+	auto line = ScanReceiverLine(entry.body.data(), entry.body.size());
+#ifdef _DEBUG
+	VerifyScan(entry.body, line, true);
+#endif
+	if (line.messageId == 0)
+		return;
+
+	auto copy = std::make_shared<LogEntry>(entry);
+	Update(line.messageId, entry, [&](MessageInfo& info) {
+		if (line.kind == MessageLine::Kind::arrived) {
+			if (entry.time >= 0)
+				info.rxTime = entry.time;
+		}
+		else if (line.kind == MessageLine::Kind::spamProfiler) {
+			info.spamProfilerScore = line.spamProfilerScore;
+			info.spamProfilerRescan = line.spamProfilerRescan;
+			info.spamProfilerBulk = line.spamProfilerBulk;
+		}
+		return AddLog(info.rxLogs, std::move(copy));
+	});
+}
+
+// the engine and sender only need the message a line mentions
+static MessageLine ScanLine(const LogEntry& entry)
+{
+	MessageLine line;
+	line.messageId = FindMessageId(entry.body.data(), entry.body.size());
+	if (line.messageId != 0)
+		line.kind = MessageLine::Kind::mentioned;
+#ifdef _DEBUG
+	VerifyScan(entry.body, line, false);
+#endif
+	return line;
+}
+
+void MessageCollector::ParseEngineLog(const LogEntry& entry)
+{
+	auto line = ScanLine(entry);
+	if (line.messageId == 0)
+		return;
+
+	auto copy = std::make_shared<LogEntry>(entry);
+	Update(line.messageId, entry, [&](MessageInfo& info) {
+		// continuation lines have no time of their own
+		if (entry.time >= 0) {
+			if (info.engTimeFirst < 0)
+				info.engTimeFirst = entry.time;
+			info.engTimeLatest = entry.time;
+		}
+		return AddLog(info.engLogs, std::move(copy));
+	});
+}
+
+void MessageCollector::ParseSenderLog(const LogEntry& entry)
+{
+	auto line = ScanLine(entry);
+	if (line.messageId == 0)
+		return;
+
+	auto copy = std::make_shared<LogEntry>(entry);
+	Update(line.messageId, entry, [&](MessageInfo& info) {
+		if (entry.time >= 0) {
+			if (info.txTimeFirst < 0)
+				info.txTimeFirst = entry.time;
+			info.txTimeLatest = entry.time;
+		}
+		return AddLog(info.txLogs, std::move(copy));
+	});
 }
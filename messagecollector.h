@@ -2,55 +2,227 @@
 
 #include <string>
 #include <boost/circular_buffer.hpp>
-#include "logfile.h"
-#include <map>
+#include "logentry.h"
+#include "flatmap.h"
+#include "messageid.h"
+#include "latencystats.h"
+#include "messageflow.h"
+#include "timerwheel.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
 
 // collects information about messages from various sources
-// specifically: MMReceiver, MMEngine and MMSender
+// specifically: MMReceiver, MMEngine and MMSender, MessageFeed hands it their lines
 
 struct MessageInfo
 {
-	std::string messageName;
+	uint64_t messageId = 0;		// the packed message name
 	boost::circular_buffer<LogEntryPtr> rxLogs;
 	boost::circular_buffer<LogEntryPtr> engLogs;
 	boost::circular_buffer<LogEntryPtr> txLogs;
 	time_t touchTime = 0;
 
-	std::string rxTime;			// time message was received
-	std::string engTimeFirst;	// earliest time message was seen in engine
-	std::string engTimeLatest;	// latest time seen, may be reprocessed or different edition
-	std::string txTimeFirst;
-	std::string txTimeLatest;
+	// times are milliseconds since midnight, -1 if not seen yet
+	int rxTime = -1;			// time message was received
+	int engTimeFirst = -1;		// earliest time message was seen in engine
+	int engTimeLatest = -1;		// latest time seen, may be reprocessed or different edition
+	int txTimeFirst = -1;
+	int txTimeLatest = -1;
 
 	int spamProfilerScore = 0;
 	int spamProfilerRescan = 0;
 	int spamProfilerBulk = 0;
 
+	uint64_t generation = 0;	// the collector's generation when it last changed
+
 	MessageInfo() : rxLogs(10), engLogs(10), txLogs(10) {}
+
+	std::string MessageName() const { return UnpackMessageId(messageId); }
+};
+
+// a copy of a message as it was at some point, the collector never changes one it's handed out
+typedef std::shared_ptr<const MessageInfo> MessageInfoPtr;
+
+// once either limit is reached the least recently seen messages are dropped
+struct MessageLimits
+{
+	size_t maxMessages = 100000;
+	size_t maxBytes = 128 * 1024 * 1024;
+
+	// seconds a message can go without reaching the next stage before it's stuck,
+	// from being received to the engine and from the engine's last look at it to being sent
+	int engineDeadline = 5 * 60;
+	int sendDeadline = 15 * 60;
 };
 
-typedef std::shared_ptr<MessageInfo> MessageInfoPtr;
+// a message that's missed the deadline for the stage it's waiting for
+struct StuckMessage
+{
+	MessageInfoPtr info;
+	MessageFlow::Stage waiting;
+	int64_t overdue;			// seconds
+};
 
-class MessageCollector : public std::enable_shared_from_this<MessageCollector>
+// A reader's copy of the collector's messages, oldest change first, that the
+// collector brings up to date. A message that changes is taken out from where it
+// was and goes on the end, one that expires is taken out, and the holes they leave
+// are only closed up once there are as many as there are messages, so keeping it
+// up to date costs what changed rather than how many there are.
+class MessageList
 {
-	std::map<std::string, MessageInfoPtr> messages_;
-	friend class LockCollector;
-	mutable std::atomic_flag lock_;
+	friend class MessageCollector;
+
+	// where the list is up to in each of the collector's shards
+	struct Shard
+	{
+		uint64_t generation = 0;
+		uint64_t expired = 0;
+		size_t count = 0;			// messages the list has from it
+		std::deque<size_t> order;	// their slots oldest first, the ones taken out are skipped when they reach the front
+	};
+
+	std::vector<MessageInfoPtr> slots_;	// null where one was taken out
+	std::vector<uint32_t> tree_;		// Fenwick tree of the slots in use, for finding the nth
+	FlatMap<size_t> where_;				// each message's slot
+	std::vector<Shard> shards_;
+	size_t size_ = 0;
+
+public:
+	MessageList() : tree_(1) {}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	// the idx'th message, oldest first
+	const MessageInfoPtr& operator[](size_t idx) const;
+
+private:
+	void Clear(size_t numShards);
+	void Append(size_t shard, MessageInfoPtr info);
+	void Remove(size_t shard, size_t slot);
+	void Expire(size_t shard, size_t count, const FlatMap<bool>& keep);
+	void Compact();
+};
+
+class MessageCollector
+{
+	// A message and the collector's book keeping for it. Readers are handed a copy
+	// of the message that's made when it's first asked for after a change, and shared
+	// until the next one, so they never see one half way through being updated.
+	// a stage's latency as it was recorded and the line that finished it, so it can
+	// be put right in the same minute if a later line changes it
+	struct Sample
+	{
+		int ms = -1;				// -1 if it hasn't been recorded
+		int day = 0;
+		int time = -1;
+	};
+
+	struct Entry
+	{
+		MessageInfo info;
+		MessageInfoPtr copy;
+		Entry* newer = nullptr;		// the shard's recently used list
+		Entry* older = nullptr;
+		size_t bytes = 0;			// roughly what the message and its log lines take up
+		uint64_t created = 0;		// the generation when it was added
+		Sample measured[LatencyStats::NumStages];
+		int reached = 0;			// the stages it's been seen at, a bit for each
+		int stage = -1;				// the latest of them
+		WheelTimer deadline;		// for the next stage, keyed on the message
+		int waiting = -1;			// the stage the deadline is for
+	};
+
+	// The messages are spread over the shards by id so the logs can be parsed on
+	// their own threads without all waiting on one lock. Each shard keeps its own
+	// recently used list, touching a message moves it to the newest end and they
+	// expire off the oldest end, so neither depends on how many there are.
+	struct Shard
+	{
+		std::atomic_flag lock;
+		FlatMap<std::unique_ptr<Entry>> messages;	// keyed on the packed message name
+		Entry* newest = nullptr;
+		Entry* oldest = nullptr;
+		size_t bytes = 0;
+		uint64_t generation = 0;	// of the latest change
+		uint64_t expired = 0;		// messages expired so far
+		size_t maxMessages = 0;		// its share of the limits
+		size_t maxBytes = 0;
+		TimerWheel deadlines;		// in seconds by the logs' clock, moved on by the lines and CheckDeadlines
+		FlatMap<Entry*> stuck;		// the messages past their deadline
+		int engineDeadline = 0;
+		int sendDeadline = 0;
+
+		Shard() { lock.clear(); }
+	};
+
+	static const size_t NumShards = 16;
+
+	mutable Shard shards_[NumShards];	// readers cache the copies they make in them
+
+	// every change takes the next generation, so in each shard the ones that changed
+	// since a reader last looked are all at the newest end, and the shards can be
+	// merged back into the order they changed in
+	std::atomic<uint64_t> generation_;
+
+	LatencyStats latency_;
+	mutable MessageFlow flow_;
+	LogClock clock_;			// the deadlines are by the logs' time, never the host's
 
 public:
 	enum class LogType { receiver, engine, sender };
 
-	MessageCollector();
+	explicit MessageCollector(const MessageLimits& limits = MessageLimits());
+
+	MessageCollector(const MessageCollector&) = delete;
+	MessageCollector& operator=(const MessageCollector&) = delete;
+
+	// a batch of lines from a log, safe from any number of threads
+	void Parse(LogType logType, const LogEntrySpan& entries);
+
+	// Brings list up to date with the messages, oldest first. Only the messages that
+	// changed since the last call with it are copied. False if nothing changed.
+	bool FillBuffer(MessageList& list) const;
+
+	void SetLimits(const MessageLimits& limits);
+	size_t NumMessages() const;
+	size_t MemoryUsed() const;
+
+	// how long messages took through each stage over the last so many minutes
+	void GetLatency(int minutes, LatencyStats::Figures (&figures)[LatencyStats::NumStages]) const;
 
-	void AddLogFile(LogType logType, LogFilePtr logFile);
+	// messages a second into each stage and how many are between them
+	MessageFlow::Figures GetFlow() const;
 
-	const void FillBuffer(std::vector<MessageInfoPtr>& buf) const;
+	// marks the messages whose deadlines have passed by the logs' clock as stuck,
+	// called on the UI's update tick rather than when it draws
+	void CheckDeadlines();
+	// the stuck messages as of the last check, in no particular order
+	void GetStuck(std::vector<StuckMessage>& stuck) const;
+	size_t NumStuck() const;
 
 private:
-	void ParseReceiverLog(LogFilePtr file, LogEntryPtr entry);
-	void ParseEngineLog(LogFilePtr file, LogEntryPtr entry);
-	void ParseSenderLog(LogFilePtr file, LogEntryPtr entry);
-	MessageInfoPtr CreateMessageInfo(const std::string msgName);
+	void ParseReceiverLog(const LogEntry& entry);
+	void ParseEngineLog(const LogEntry& entry);
+	void ParseSenderLog(const LogEntry& entry);
+
+	// runs update on the message under its shard's lock, adding it if it's new,
+	// line is the log line it's for
+	template <typename F>
+	void Update(uint64_t msgId, const LogEntry& line, F&& update);
+
+	Shard& ShardOf(uint64_t msgId) const;
+	static MessageInfoPtr CopyOf(Entry& entry);
+	void Touch(Shard& shard, Entry* entry);
+	void Unlink(Shard& shard, Entry* entry);
+	void Expire(Shard& shard);
+	static int Measure(Entry& entry, const LogEntry& line, Sample (&previous)[LatencyStats::NumStages]);
+	static int Reach(Entry& entry);
+	void Watch(Shard& shard, Entry& entry, int reached, bool engine, int64_t second);
+	static void Schedule(Shard& shard, Entry& entry, MessageFlow::Stage waiting, int64_t expires);
+	static void Advance(Shard& shard, int64_t second);
 };
 
 typedef std::shared_ptr<MessageCollector> MessageCollectorPtr;
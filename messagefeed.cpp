@@ -0,0 +1,52 @@
+#include "messagefeed.h"
+#include <algorithm>
+
+MessageFeed::MessageFeed(MessageCollectorPtr collector)
+	: collector_(collector)
+{
+}
+
+MessageFeed::~MessageFeed()
+{
+	Stop();
+}
+
+void MessageFeed::Stop()
+{
+	for (auto& dispatcher : dispatchers_) {
+		if (dispatcher)
+			dispatcher->Stop();
+	}
+}
+
+void MessageFeed::AddLogFile(MessageCollector::LogType logType, LogFilePtr logFile)
+{
+	auto& dispatcher = dispatchers_[(int)logType];
+	if (!dispatcher) {
+		// if we fall behind the entries are held back and merged rather than dropped, up to 64K
+		// entries for each log, past that they're dropped and counted in the dispatch stats.
+		// The dispatchers are stopped before the feed lets go of the collector
+		auto collector = collector_.get();
+		dispatcher = std::make_shared<AsyncSubscriber>([collector](const LogFilePtr& file, int tag, const LogEntrySpan& entries) {
+			collector->Parse((MessageCollector::LogType)tag, entries);
+		}, AsyncSubscriber::Policy::coalesce);
+	}
+	dispatcher->Subscribe(logFile, (int)logType);
+}
+
+AsyncSubscriber::Stats MessageFeed::GetStats() const
+{
+	AsyncSubscriber::Stats total;
+	for (const auto& dispatcher : dispatchers_) {
+		if (!dispatcher)
+			continue;
+		auto stats = dispatcher->GetStats();
+		total.depth += stats.depth;
+		total.capacity += stats.capacity;
+		total.batches += stats.batches;
+		total.entries += stats.entries;
+		total.dropped += stats.dropped;
+		total.lag = std::max(total.lag, stats.lag);
+	}
+	return total;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "messagecollector.h"
+#include "asyncsubscriber.h"
+
+// Hands the lines from the receiver, engine and sender logs to a collector. They're
+// parsed on a thread for each type rather than the tailer's, so a slow parse
+// doesn't hold up the other logs.
+class MessageFeed
+{
+	MessageCollectorPtr collector_;
+	AsyncSubscriberPtr dispatchers_[3];
+
+public:
+	explicit MessageFeed(MessageCollectorPtr collector);
+	~MessageFeed();
+
+	MessageFeed(const MessageFeed&) = delete;
+	MessageFeed& operator=(const MessageFeed&) = delete;
+
+	void AddLogFile(MessageCollector::LogType logType, LogFilePtr logFile);
+
+	// stops parsing the logs and waits for the dispatchers, so nothing is left
+	// running on their threads when the logs or the collector go
+	void Stop();
+
+	// between the dispatchers, the lag is the worst of them
+	AsyncSubscriber::Stats GetStats() const;
+};
+
+typedef std::shared_ptr<MessageFeed> MessageFeedPtr;
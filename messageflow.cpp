@@ -0,0 +1,99 @@
+#include "messageflow.h"
+#include "logtime.h"
+#include <algorithm>
+
+// the moving average takes about a minute to catch up, a line that's a little late
+// still counts towards it in the current second, one that's later than that doesn't
+static const double Decay = 0.98347;		// exp(-1 / 60)
+static const int64_t LateSeconds = 5;
+
+MessageFlow::MessageFlow()
+	: history_(new Second[HistorySeconds])
+{
+}
+
+void MessageFlow::Enter(Stage stage, int day, int time)
+{
+	int64_t second = LogClock::Second(day, time);
+	clock_.Observe(second);
+
+	std::lock_guard<std::mutex> guard(lock_);
+	if (first_ < 0)
+		first_ = second;
+	if (second > current_)
+		Advance(second);
+
+	if (second > current_ - HistorySeconds) {
+		auto& slot = history_[second % HistorySeconds];
+		if (slot.second == second) {
+			slot.counts[stage]++;
+			hourTotals_[stage]++;
+		}
+	}
+	if (second > current_ - LateSeconds)
+		pending_[stage]++;
+}
+
+void MessageFlow::Move(int from, int to)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	if (from >= 0)
+		counts_[from]--;
+	counts_[to]++;
+}
+
+void MessageFlow::Forget(int stage)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	counts_[stage]--;
+}
+
+MessageFlow::Figures MessageFlow::GetFigures()
+{
+	// the rates fall away when the logs go quiet, so bring them up to now by the logs
+	int64_t now = clock_.Now();
+
+	Figures figures;
+	std::lock_guard<std::mutex> guard(lock_);
+	if (current_ >= 0 && now > current_)
+		Advance(now);
+
+	int64_t seconds = std::max<int64_t>(1, std::min<int64_t>(HistorySeconds, current_ - first_ + 1));
+	for (int i = 0; i < NumStages; i++) {
+		figures.rate[i] = rates_[i];
+		figures.hourRate[i] = (double)hourTotals_[i] / seconds;
+	}
+	figures.awaitingEngine = counts_[received];
+	figures.inEngine = counts_[engine];
+	return figures;
+}
+
+// moves on to a later second, each second passed folds into the moving average and
+// takes its slot in the ring, which is at most a pass round it after a long gap
+void MessageFlow::Advance(int64_t second)
+{
+	if (current_ < 0) {
+		current_ = second - 1;
+	}
+	else if (second - current_ > HistorySeconds) {
+		// nothing for an hour, the average would have decayed to nothing anyway
+		for (int i = 0; i < NumStages; i++) {
+			rates_[i] = 0;
+			pending_[i] = 0;
+		}
+		current_ = second - HistorySeconds;
+	}
+
+	while (current_ < second) {
+		for (int i = 0; i < NumStages; i++) {
+			rates_[i] = rates_[i] * Decay + pending_[i] * (1 - Decay);
+			pending_[i] = 0;
+		}
+		current_++;
+		auto& slot = history_[current_ % HistorySeconds];
+		for (int i = 0; i < NumStages; i++)
+			hourTotals_[i] -= slot.counts[i];
+		slot = Second();
+		slot.second = current_;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "logtime.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// How many messages go into each stage of MailMarshal a second, and how many are
+// part way through. The rates are kept by the log time of the line that showed a
+// message reaching a stage, as a moving average and a count for each second of the
+// last hour, and each message's stage is followed so the numbers between stages
+// are exact counts rather than the difference of two rates. Everything is kept up
+// to date as the events come in, nothing is ever counted again, and it's all by
+// the logs' clock so it doesn't matter how far this machine's is from it.
+class MessageFlow
+{
+public:
+	enum Stage { received, engine, sent, NumStages };
+
+	struct Figures
+	{
+		double rate[NumStages] = {};		// smoothed over about a minute
+		double hourRate[NumStages] = {};	// the average over the last hour
+		int64_t awaitingEngine = 0;			// received and not seen in the engine yet
+		int64_t inEngine = 0;				// seen in the engine and not in the sender yet
+	};
+
+	static const int HistorySeconds = 60 * 60;
+
+	MessageFlow();
+
+	// a message reached a stage, day and time are the line that showed it
+	void Enter(Stage stage, int day, int time);
+
+	// a message moved on to a later stage, from is -1 if it's new
+	void Move(int from, int to);
+
+	// a message that's no longer followed
+	void Forget(int stage);
+
+	Figures GetFigures();
+
+private:
+	struct Second
+	{
+		int64_t second = -1;
+		uint32_t counts[NumStages] = {};
+	};
+
+	std::mutex lock_;
+	LogClock clock_;
+	std::unique_ptr<Second[]> history_;		// a ring, by second
+	int64_t current_ = -1;					// the latest second
+	int64_t first_ = -1;					// and the first one, for the average before there's an hour
+	uint64_t hourTotals_[NumStages] = {};	// of the ring
+	uint32_t pending_[NumStages] = {};		// so far in the current second
+	double rates_[NumStages] = {};
+	int64_t counts_[NumStages] = {};		// messages at each stage
+
+	void Advance(int64_t second);
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// MailMarshal message names are a letter A-E and 12 hex digits ("B5f3e6c1a0d42"
+// and so on, before the ".xxxxxxxxxxxx.xxxx.mml"), which packs into an integer:
+// the digits take the low 48 bits, the letter (1-5) the 3 above them and the
+// case of each hex letter the 12 above that, so the name can be rebuilt exactly.
+// 0 is never a valid id.
+const size_t MessageNameLength = 13;
+
+inline int HexDigit(char c)
+{
+	if ((unsigned char)(c - '0') <= 9)
+		return c - '0';
+	if ((unsigned char)(c - 'a') <= 5)
+		return c - 'a' + 10;
+	if ((unsigned char)(c - 'A') <= 5)
+		return c - 'A' + 10;
+	return -1;
+}
+
+// p must have MessageNameLength chars, returns 0 if they aren't a message name
+inline uint64_t PackMessageId(const char* p)
+{
+	if ((unsigned char)(p[0] - 'A') > 4)
+		return 0;
+	uint64_t digits = 0;
+	uint64_t lower = 0;
+	for (size_t i = 1; i < MessageNameLength; i++) {
+		int digit = HexDigit(p[i]);
+		if (digit < 0)
+			return 0;
+		digits = digits << 4 | (uint64_t)digit;
+		lower = lower << 1 | (p[i] >= 'a' ? 1 : 0);
+	}
+	return lower << 51 | (uint64_t)(p[0] - 'A' + 1) << 48 | digits;
+}
+
+inline uint64_t PackMessageId(const std::string& name)
+{
+	return name.size() == MessageNameLength ? PackMessageId(name.data()) : 0;
+}
+
+inline std::string UnpackMessageId(uint64_t id)
+{
+	static const char Upper[] = "0123456789ABCDEF";
+	static const char Lower[] = "0123456789abcdef";
+	uint64_t digits = id & 0xffffffffffffull;
+	uint64_t lower = id >> 51;
+	std::string name(MessageNameLength, ' ');
+	name[0] = (char)('A' + (int)(id >> 48 & 7) - 1);
+	for (size_t i = MessageNameLength - 1; i >= 1; i--) {
+		name[i] = ((lower & 1) != 0 ? Lower : Upper)[digits & 15];
+		digits >>= 4;
+		lower >>= 1;
+	}
+	return name;
+}
@@ -0,0 +1,155 @@
+#include "messagescanner.h"
+#include <cstring>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// what the patterns took \s and \w to mean
+static bool IsSpace(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool IsWord(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+// the packed name if p starts with a message file name, 0 if it doesn't
+static uint64_t MatchFileName(const char* p)
+{
+	const char* suffix = p + MessageNameLength;
+	if (suffix[0] != '.' || suffix[13] != '.' || memcmp(suffix + 18, ".mml", 4) != 0)
+		return 0;
+	for (int i = 1; i < 18; i++) {
+		if (i != 13 && HexDigit(suffix[i]) < 0)
+			return 0;
+	}
+	return PackMessageId(p);
+}
+
+uint64_t FindMessageId(const char* text, size_t length)
+{
+	// every ".mml" far enough in to have a name in front of it is a candidate,
+	// the first one that does is where the patterns would have matched
+	const size_t first = MessageFileNameLength - 4;
+	if (length < MessageFileNameLength)
+		return 0;
+
+	size_t i = first;
+	const __m128i dot = _mm_set1_epi8('.');
+	const __m128i m = _mm_set1_epi8('m');
+	const __m128i l = _mm_set1_epi8('l');
+	for (; i + 16 + 3 <= length; i += 16) {
+		auto at = [&](size_t offset) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + offset)); };
+		__m128i found = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(at(0), dot), _mm_cmpeq_epi8(at(1), m)),
+			_mm_and_si128(_mm_cmpeq_epi8(at(2), m), _mm_cmpeq_epi8(at(3), l)));
+		unsigned mask = (unsigned)_mm_movemask_epi8(found);
+		while (mask != 0) {
+#ifdef _MSC_VER
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+#else
+			unsigned bit = (unsigned)__builtin_ctz(mask);
+#endif
+			auto id = MatchFileName(text + i + bit - first);
+			if (id != 0)
+				return id;
+			mask &= mask - 1;
+		}
+	}
+	for (; i + 4 <= length; i++) {
+		if (text[i] == '.' && memcmp(text + i + 1, "mml", 3) == 0) {
+			auto id = MatchFileName(text + i - first);
+			if (id != 0)
+				return id;
+		}
+	}
+	return 0;
+}
+
+// a small cursor over the line for matching the fixed parts of it
+class TextCursor
+{
+	const char* p_;
+	const char* end_;
+
+public:
+	TextCursor(const char* text, size_t length) : p_(text), end_(text + length) {}
+
+	const char* Position() const { return p_; }
+	bool AtEnd() const { return p_ == end_; }
+
+	bool Literal(const char* literal)
+	{
+		size_t n = strlen(literal);
+		if ((size_t)(end_ - p_) < n || memcmp(p_, literal, n) != 0)
+			return false;
+		p_ += n;
+		return true;
+	}
+
+	bool Space()
+	{
+		if (p_ == end_ || !IsSpace(*p_))
+			return false;
+		p_++;
+		return true;
+	}
+
+	// a literal with a single space before it
+	bool Word(const char* literal) { return Space() && Literal(literal); }
+
+	bool Identifier(const char*& start, size_t& length)
+	{
+		start = p_;
+		while (p_ != end_ && IsWord(*p_))
+			p_++;
+		length = p_ - start;
+		return length > 0;
+	}
+
+	bool Number(int& value)
+	{
+		value = 0;
+		const char* start = p_;
+		while (p_ != end_ && *p_ >= '0' && *p_ <= '9')
+			value = value * 10 + (*p_++ - '0');
+		return p_ != start;
+	}
+};
+
+MessageLine ScanReceiverLine(const char* text, size_t length)
+{
+	MessageLine line;
+
+	TextCursor arrived(text, length);
+	const char* name;
+	size_t nameLength;
+	if (arrived.Literal("TX:") && arrived.Word("<250") && arrived.Space() && arrived.Identifier(name, nameLength)
+		&& arrived.Word("Message") && arrived.Word("accepted") && arrived.Word("for") && arrived.Word("delivery>")
+		&& arrived.AtEnd()) {
+		line.kind = MessageLine::Kind::arrived;
+		line.messageId = nameLength == MessageNameLength ? PackMessageId(name) : 0;
+		return line;
+	}
+
+	if (length >= MessageFileNameLength) {
+		auto id = MatchFileName(text);
+		TextCursor scores(text + MessageFileNameLength, length - MessageFileNameLength);
+		if (id != 0 && scores.Word("SpamProfiler") && scores.Word("score:") && scores.Space() && scores.Number(line.spamProfilerScore)
+			&& scores.Literal(",") && scores.Word("rescan:") && scores.Space() && scores.Number(line.spamProfilerRescan)
+			&& scores.Literal(",") && scores.Word("bulk:") && scores.Space() && scores.Number(line.spamProfilerBulk)) {
+			line.kind = MessageLine::Kind::spamProfiler;
+			line.messageId = id;
+			return line;
+		}
+		line.spamProfilerScore = line.spamProfilerRescan = line.spamProfilerBulk = 0;
+	}
+
+	line.messageId = FindMessageId(text, length);
+	if (line.messageId != 0)
+		line.kind = MessageLine::Kind::mentioned;
+	return line;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "messageid.h"
+#include <cstddef>
+
+// Picks out the lines in the MMReceiver, MMEngine and MMSender logs that say
+// something about a message, in a single pass over each line. Nearly every line
+// doesn't mention one, so the search for the ".mml" that ends a message file name
+// goes 16 bytes at a time and the name in front of it is only checked when found.
+
+// a message file name, "B5f3e6c1a0d42.xxxxxxxxxxxx.xxxx.mml"
+const size_t MessageFileNameLength = MessageNameLength + 22;
+
+struct MessageLine
+{
+	enum class Kind { none, arrived, spamProfiler, mentioned };
+
+	Kind kind = Kind::none;
+	uint64_t messageId = 0;		// 0 if the name in an arrived line isn't a message name
+	int spamProfilerScore = 0;
+	int spamProfilerRescan = 0;
+	int spamProfilerBulk = 0;
+};
+
+// the first message file name in the text, 0 if there isn't one
+uint64_t FindMessageId(const char* text, size_t length);
+
+// "TX: <250 name Message accepted for delivery>", then a line starting with a file
+// name and its SpamProfiler scores, then any line with a file name in it
+MessageLine ScanReceiverLine(const char* text, size_t length);
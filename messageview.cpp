@@ -1,10 +1,9 @@
 #include "messageview.h"
 #include <algorithm>
 
-MessageView::MessageView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector)
-	: ui_(ui), win_(win), collector_(collector)
+MessageView::MessageView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector, MessageFeedPtr feed)
+	: ui_(ui), win_(win), collector_(collector), feed_(feed)
 {
-	buffer_.reserve(5000);
 }
 
 MessageView::~MessageView()
@@ -38,6 +37,7 @@ void MessageView::CalculateMessageViewSize()
 	int maxy = win_->GetMaxY();
 	msgBegY_ = 2;
 	msgEndY_ = (int)(maxy * .4);
+	statsEndY_ = msgEndY_ + 1 + LatencyStats::NumStages;
 }
 
 bool MessageView::Update(int c)
@@ -97,7 +97,8 @@ void MessageView::Render()
 	}
 
 	RenderMessageView(0, msgEndY_);
-	RenderDetailView(msgEndY_, maxy);
+	RenderStatsView(msgEndY_, statsEndY_);
+	RenderDetailView(statsEndY_, maxy);
 
 	SetPosition();
 	win_->Touch();
@@ -140,10 +141,10 @@ void MessageView::RenderMessageView(int starty, int maxy)
 			// render columns
 			win_->PrintF(i, 1, maxx, "");
 
-			win_->PrintF(i, 2, 15, "%s", msg->messageName.c_str());
-			win_->PrintF(i, 20, 15, "%s", msg->rxTime.c_str());
-			win_->PrintF(i, 40, 15, "%s", msg->engTimeLatest.c_str());
-			win_->PrintF(i, 60, 15, "%s", msg->txTimeLatest.c_str());
+			win_->PrintF(i, 2, 15, "%s", msg->MessageName().c_str());
+			win_->PrintF(i, 20, 15, "%s", TimeText(msg->rxTime).c_str());
+			win_->PrintF(i, 40, 15, "%s", TimeText(msg->engTimeLatest).c_str());
+			win_->PrintF(i, 60, 15, "%s", TimeText(msg->txTimeLatest).c_str());
 			win_->PrintF(i, 82, 15, "%3d", msg->spamProfilerScore);
 			win_->PrintF(i, 86, 4, "%c%c", msg->spamProfilerRescan ? 'R' : '.', msg->spamProfilerBulk ? 'B' : '.');
 			win_->ClearToEol();
@@ -161,6 +162,56 @@ void MessageView::RenderMessageView(int starty, int maxy)
 	}
 }
 
+// a latency short enough to fit in a column
+static std::string LatencyText(int ms)
+{
+	char text[32];
+	if (ms < 1000)
+		snprintf(text, sizeof(text), "%dms", ms);
+	else if (ms < 60 * 1000)
+		snprintf(text, sizeof(text), "%.1fs", ms / 1000.0);
+	else
+		snprintf(text, sizeof(text), "%dm%02ds", ms / 60000, ms / 1000 % 60);
+	return text;
+}
+
+void MessageView::RenderStatsView(int starty, int maxy)
+{
+	static const char* StageNames[LatencyStats::NumStages] = { "Receive > Engine", "Engine processing", "Engine > Send" };
+	static const int Minutes[] = { 1, 15 };
+	static const char* MinutesNames[] = { "Last minute", "Last 15 minutes" };
+	const int StageWidth = 20;
+	const int FiguresWidth = 46;
+
+	int y = starty;
+	int maxx = win_->GetMaxX();
+	win_->AttrOn(COLOR_PAIR(LM_STATUS_BAR));
+	win_->PrintF(y, 0, maxx, "");
+	win_->PrintF(y, 2, StageWidth, "Latency");
+	for (int i = 0; i < 2; i++)
+		win_->PrintF(y, 2 + StageWidth + i * FiguresWidth, FiguresWidth, "%s", MinutesNames[i]);
+	win_->AttrOff(COLOR_PAIR(LM_STATUS_BAR));
+	y++;
+
+	LatencyStats::Figures figures[2][LatencyStats::NumStages];
+	for (int i = 0; i < 2; i++)
+		collector_->GetLatency(Minutes[i], figures[i]);
+
+	for (int stage = 0; stage < LatencyStats::NumStages && y < maxy; stage++, y++) {
+		win_->Move(y, 0);
+		win_->ClearToEol();
+		win_->PrintF(y, 2, StageWidth, "%s", StageNames[stage]);
+		for (int i = 0; i < 2; i++) {
+			const auto& f = figures[i][stage];
+			if (f.count == 0)
+				continue;
+			win_->PrintF(y, 2 + StageWidth + i * FiguresWidth, FiguresWidth, "%6llu  p50 %-6s p90 %-6s p99 %-6s max %s",
+				(unsigned long long)f.count, LatencyText(f.p50).c_str(), LatencyText(f.p90).c_str(),
+				LatencyText(f.p99).c_str(), LatencyText(f.max).c_str());
+		}
+	}
+}
+
 void MessageView::RenderDetailView(int starty, int maxy)
 {
 	int y = starty;
@@ -219,7 +270,7 @@ int MessageView::RenderDetailLogView(int starty, int maxy, const char* title, co
 		win_->AttrOff(COLOR_PAIR(LM_THREAD_ID));
 
 		win_->AttrOn(COLOR_PAIR(LM_TIMESTAMP));
-		win_->PrintF(y, x, TimeWidth, "%s", log->time.c_str()); x += TimeWidth; width -= TimeWidth;
+		win_->PrintF(y, x, TimeWidth, "%s", TimeText(log->time).c_str()); x += TimeWidth; width -= TimeWidth;
 		win_->AttrOff(COLOR_PAIR(LM_TIMESTAMP));
 
 		win_->PrintF(y, x, width, "%s", log->body.c_str());
@@ -237,7 +288,6 @@ void MessageView::Resize()
 void MessageView::RefreshBuffer()
 {
 	if (tail_) {
-		buffer_.clear();
 		collector_->FillBuffer(buffer_);
 		selectedIdx_ = buffer_.size() == 0 ? 0 : (int)buffer_.size() - 1;
 		if (startRow_ > buffer_.size())
@@ -247,7 +297,10 @@ void MessageView::RefreshBuffer()
 
 void MessageView::SetPosition()
 {
+	auto stats = feed_->GetStats();
 	ui_->SetStatus(0, 0, "");
-	ui_->SetStatus(1, 0, "");
+	ui_->SetStatus(1, LM_STATUS_BAR, "  %d messages, %d MB (queued %d of %d, lag %d ms, dropped %llu)",
+		(int)collector_->NumMessages(), (int)(collector_->MemoryUsed() >> 20), (int)stats.depth, (int)stats.capacity,
+		stats.lag, (unsigned long long)stats.dropped);
 	ui_->SetStatus(2, tail_ ? LM_STATUS_TAIL : LM_STATUS_PAUSED, " [%s] %s", tail_ ? "Tail" : "Paused", !tail_ ? " press enter to continue " : "");
 }
@@ -2,6 +2,7 @@
 
 #include "view.h"
 #include "messagecollector.h"
+#include "messagefeed.h"
 #include "mainui.h"
 #include <vector>
 
@@ -10,10 +11,11 @@ class MessageView : public View
 	MainUi* ui_;
 	std::shared_ptr<Window> win_;
 	MessageCollectorPtr collector_;
-	std::vector<MessageInfoPtr> buffer_;
+	MessageFeedPtr feed_;			// for how far behind the logs it is
+	MessageList buffer_;			// only the collector changes it
 
 public:
-	MessageView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector);
+	MessageView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector, MessageFeedPtr feed);
 	~MessageView();
 
 	virtual void Init();
@@ -27,11 +29,13 @@ private:
 
 	int msgBegY_;	// screen position of beggining of row
 	int msgEndY_;	// use to see if selected message is visible
+	int statsEndY_;	// the latency panel is between the messages and the details
 	int startRow_ = 0;	// the index in the buffer that is rendered as the beginning row
 	int selectedIdx_ = 0;
 	bool tail_ = true;
 
 	void RenderMessageView(int starty, int maxy);
+	void RenderStatsView(int starty, int maxy);
 	void RenderDetailView(int starty, int maxy);
 	int RenderDetailLogView(int starty, int maxy, const char* title, const boost::circular_buffer<LogEntryPtr>& logs);
 	void EnsureVisible();
@@ -13,12 +13,43 @@
 #include <Windows.h>
 
 
-int main()
+int main(int argc, char* argv[])
 {
 	try {
 		CoInitializeEx(NULL, COINIT_MULTITHREADED);
 
-		MainUi ui;
+		// -backfill <MB> and -minutes <n> read back through the rotated logs at startup,
+		// -memory <MB> is what the log buffers can use between them, -index shows the
+		// whole of each log file by indexing it rather than what's in the buffers,
+		// -messages <n> and -messagememory <MB> cap what the message view keeps track of,
+		// -enginedeadline <s> and -senddeadline <s> are how long a message can wait for
+		// the engine and then the sender before it's shown as stuck
+		BackfillOptions backfill;
+		size_t memoryBudget = LogTailer::DefaultBudget;
+		bool indexFiles = false;
+		MessageLimits messageLimits;
+		for (int i = 1; i < argc; i++) {
+			if (_stricmp(argv[i], "-index") == 0)
+				indexFiles = true;
+			else if (i + 1 == argc)
+				break;
+			else if (_stricmp(argv[i], "-backfill") == 0)
+				backfill.maxBytes = _atoi64(argv[++i]) * 1024 * 1024;
+			else if (_stricmp(argv[i], "-minutes") == 0)
+				backfill.minutes = atoi(argv[++i]);
+			else if (_stricmp(argv[i], "-memory") == 0)
+				memoryBudget = (size_t)std::max<int64_t>(1, _atoi64(argv[++i])) * 1024 * 1024;
+			else if (_stricmp(argv[i], "-messages") == 0)
+				messageLimits.maxMessages = (size_t)std::max<int64_t>(1, _atoi64(argv[++i]));
+			else if (_stricmp(argv[i], "-messagememory") == 0)
+				messageLimits.maxBytes = (size_t)std::max<int64_t>(1, _atoi64(argv[++i])) * 1024 * 1024;
+			else if (_stricmp(argv[i], "-enginedeadline") == 0)
+				messageLimits.engineDeadline = std::max(1, atoi(argv[++i]));
+			else if (_stricmp(argv[i], "-senddeadline") == 0)
+				messageLimits.sendDeadline = std::max(1, atoi(argv[++i]));
+		}
+
+		MainUi ui(backfill, memoryBudget, indexFiles, messageLimits);
 		ui.Run();
 	}
 	catch (std::exception& e) {
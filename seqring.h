@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// A fixed size ring of shared_ptr<T> with one writer and any number of readers.
+// Every push gets the next sequence number and the writer never waits on the
+// readers. Readers look at the ring through a Reader, which pins an epoch so
+// nothing it can see is freed while it's alive, and each slot carries the
+// sequence of what's in it so a reader can tell when it has been overwritten.
+// Items can be pushed with a weight, the writer can see the total weight of the
+// items in the ring and of those dropped that a reader could still be holding.
+template <typename T>
+class SeqRing
+{
+	static const int MaxReaders = 16;
+	static const uint64_t Empty = ~0ULL;
+
+	struct Slot
+	{
+		std::atomic<uint64_t> seq;
+		std::atomic<const T*> item;
+	};
+
+	std::unique_ptr<Slot[]> slots_;
+	size_t capacity_;
+	std::atomic<uint64_t> head_;		// sequence of the next push
+	std::atomic<uint64_t> tail_;		// sequence of the oldest item still in the ring
+	std::atomic<uint64_t> epoch_;
+	mutable std::atomic<uint64_t> readers_[MaxReaders];	// epoch each reader pinned, 0 if the slot's free
+
+	// only touched by the writer, owners_ keeps the items in the ring alive and the
+	// overwritten ones wait in retired_ until no reader could still be looking at them
+	struct Retired
+	{
+		uint64_t epoch;
+		size_t weight;
+		std::shared_ptr<T> item;
+	};
+	std::vector<std::shared_ptr<T>> owners_;
+	std::vector<size_t> weights_;
+	std::deque<Retired> retired_;
+	size_t weight_ = 0;			// of the items in owners_ and retired_
+	size_t retiredWeight_ = 0;
+
+public:
+	explicit SeqRing(size_t capacity)
+		: slots_(new Slot[capacity]), capacity_(capacity), head_(0), tail_(0), epoch_(1), owners_(capacity), weights_(capacity)
+	{
+		for (size_t i = 0; i < capacity_; i++) {
+			slots_[i].seq.store(Empty, std::memory_order_relaxed);
+			slots_[i].item.store(nullptr, std::memory_order_relaxed);
+		}
+		for (auto& reader : readers_)
+			reader.store(0, std::memory_order_relaxed);
+	}
+
+	SeqRing(const SeqRing&) = delete;
+	SeqRing& operator=(const SeqRing&) = delete;
+
+	size_t Capacity() const { return capacity_; }
+	uint64_t Head() const { return head_.load(std::memory_order_acquire); }
+	uint64_t Tail() const { return tail_.load(std::memory_order_acquire); }
+	size_t Size() const
+	{
+		uint64_t tail = Tail();
+		return (size_t)(Head() - tail);
+	}
+
+	// writer only, what the items held and what's waiting to be freed
+	size_t Weight() const { return weight_; }
+	size_t RetiredWeight() const { return retiredWeight_; }
+
+	// writer only
+	void Push(std::shared_ptr<T> item, size_t weight = 0)
+	{
+		uint64_t seq = head_.load(std::memory_order_relaxed);
+		auto& slot = slots_[seq % capacity_];
+		auto& owner = owners_[seq % capacity_];
+
+		// mark the slot as changing before the item is swapped so a reader that
+		// loads the new item can't mistake it for the old sequence
+		slot.seq.store(Empty, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.item.store(item.get(), std::memory_order_seq_cst);
+		slot.seq.store(seq, std::memory_order_release);
+		if (seq - tail_.load(std::memory_order_relaxed) == capacity_)
+			tail_.store(seq + 1 - capacity_, std::memory_order_release);
+		head_.store(seq + 1, std::memory_order_release);
+
+		if (owner)
+			Retire(std::move(owner), weights_[seq % capacity_]);
+		owner = std::move(item);
+		weights_[seq % capacity_] = weight;
+		weight_ += weight;
+	}
+
+	// writer only, drops the oldest item before the ring wraps round to it, it's
+	// freed straight away unless a reader could still be looking at it
+	void Drop()
+	{
+		uint64_t seq = tail_.load(std::memory_order_relaxed);
+		if (seq == head_.load(std::memory_order_relaxed))
+			return;
+		auto& slot = slots_[seq % capacity_];
+		tail_.store(seq + 1, std::memory_order_release);
+		slot.seq.store(Empty, std::memory_order_release);
+		slot.item.store(nullptr, std::memory_order_seq_cst);
+		Retire(std::move(owners_[seq % capacity_]), weights_[seq % capacity_]);
+		Reclaim();
+	}
+
+	// writer only, frees the retired items older than every pinned epoch
+	void Reclaim()
+	{
+		uint64_t oldest = ~0ULL;
+		for (const auto& reader : readers_) {
+			uint64_t epoch = reader.load(std::memory_order_seq_cst);
+			if (epoch != 0 && epoch < oldest)
+				oldest = epoch;
+		}
+		while (!retired_.empty() && retired_.front().epoch < oldest) {
+			weight_ -= retired_.front().weight;
+			retiredWeight_ -= retired_.front().weight;
+			retired_.pop_front();
+		}
+	}
+
+	class Reader
+	{
+		const SeqRing& ring_;
+		int slot_;
+		uint64_t tail_;
+		uint64_t head_;
+
+	public:
+		explicit Reader(const SeqRing& ring) : ring_(ring), slot_(ring.Pin())
+		{
+			// the writer can push past a whole ring between the two loads, anything
+			// older than a ring behind head has been overwritten by then
+			tail_ = ring_.Tail();
+			head_ = ring_.Head();
+			if (head_ - tail_ > ring_.capacity_)
+				tail_ = head_ - ring_.capacity_;
+		}
+		~Reader() { ring_.Unpin(slot_); }
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		// the range of sequences when the reader was created
+		uint64_t Tail() const { return tail_; }
+		uint64_t Head() const { return head_; }
+		size_t Size() const { return (size_t)(head_ - tail_); }
+
+		// null if the writer has moved past seq, the item stays valid while the reader is alive
+		const T* Get(uint64_t seq) const { return ring_.Load(seq); }
+	};
+
+private:
+	int Pin() const
+	{
+		for (;;) {
+			for (int i = 0; i < MaxReaders; i++) {
+				uint64_t free = 0;
+				if (readers_[i].load(std::memory_order_relaxed) == 0
+					&& readers_[i].compare_exchange_strong(free, epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst))
+					return i;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	void Unpin(int slot) const
+	{
+		readers_[slot].store(0, std::memory_order_release);
+	}
+
+	const T* Load(uint64_t seq) const
+	{
+		const auto& slot = slots_[seq % capacity_];
+		if (slot.seq.load(std::memory_order_acquire) != seq)
+			return nullptr;
+		const T* item = slot.item.load(std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != seq)
+			return nullptr;
+		return item;
+	}
+
+	void Retire(std::shared_ptr<T>&& item, size_t weight)
+	{
+		// readers that pin the epoch from here on can't reach the item
+		retired_.push_back(Retired{ epoch_.fetch_add(1, std::memory_order_seq_cst), weight, std::move(item) });
+		retiredWeight_ += weight;
+		if (retired_.size() >= 64)
+			Reclaim();
+	}
+};
@@ -0,0 +1,171 @@
+#include "spillstore.h"
+#include <algorithm>
+#include <atomic>
+
+// segments are kept small enough that a few can be mapped at once even in a 32 bit build
+static const int64_t SegmentSize = 32 * 1024 * 1024;
+static const int64_t MaxSpillBytes = 512 * 1024 * 1024;
+static const size_t MaxMapped = 4;
+
+struct SpillStore::MappedSegment
+{
+	uint32_t id = 0;
+	HANDLE mapping = nullptr;
+	const char* view = nullptr;
+	int64_t size = 0;		// how much of the segment is mapped
+
+	~MappedSegment()
+	{
+		if (view)
+			UnmapViewOfFile(view);
+		if (mapping)
+			CloseHandle(mapping);
+	}
+};
+
+SpillStore::SpillStore(const std::string& name)
+	: name_(name)
+{
+	static std::atomic<uint32_t> nextStore(0);
+	storeId_ = nextStore++;
+}
+
+SpillStore::~SpillStore()
+{
+	for (auto& segment : segments_)
+		CloseHandle(segment.file);
+}
+
+SpillStore::Segment* SpillStore::OpenSegment()
+{
+	auto filename = "mlog-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(storeId_) + "-" + name_ + "-" + std::to_string(nextSegment_) + ".seg";
+	auto path = fs::temp_directory_path() / filename;
+
+	// share delete so the views can still be mapped once the segment's been dropped
+	Segment segment;
+	segment.file = CreateFile(path.string().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+		nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (segment.file == INVALID_HANDLE_VALUE) {
+		DLog("Cannot create spill segment %s, err=%d\n", path.string().c_str(), (int)GetLastError());
+		return nullptr;
+	}
+	segment.id = nextSegment_++;
+	segments_.push_back(segment);
+	return &segments_.back();
+}
+
+void SpillStore::DropOldestSegment()
+{
+	uint32_t id = segments_.front().id;
+	while (!index_.empty() && index_.front().segment == id)
+		index_.pop_front();
+	totalBytes_ -= segments_.front().size;
+	// any views of it keep the file until they're unmapped
+	CloseHandle(segments_.front().file);
+	segments_.pop_front();
+}
+
+void SpillStore::Append(const LogChunk& chunk)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	if (failed_)
+		return;
+
+	// blocks are padded out to 8 bytes so each one can be read in place
+	size_t size = chunk.SerializedSize();
+	size_t padded = (size + 7) & ~(size_t)7;
+	scratch_.assign(padded, 0);
+	chunk.Serialize(scratch_.data());
+
+	Segment* segment = segments_.empty() ? nullptr : &segments_.back();
+	if (segment == nullptr || segment->size + (int64_t)padded > SegmentSize)
+		segment = OpenSegment();
+	DWORD written = 0;
+	if (segment == nullptr || !WriteFile(segment->file, scratch_.data(), (DWORD)padded, &written, nullptr) || written != padded) {
+		// the lines on disk have to follow on from each other, so give up on spilling altogether
+		DLog("Spilling %s failed, err=%d\n", name_.c_str(), (int)GetLastError());
+		while (!segments_.empty())
+			DropOldestSegment();
+		failed_ = true;
+		return;
+	}
+
+	IndexEntry entry;
+	entry.first = chunk.First();
+	entry.count = (uint32_t)chunk.Count();
+	entry.segment = segment->id;
+	entry.offset = segment->size;
+	index_.push_back(entry);
+	segment->size += padded;
+	totalBytes_ += padded;
+
+	while (totalBytes_ > MaxSpillBytes && segments_.size() > 1)
+		DropOldestSegment();
+}
+
+bool SpillStore::Failed() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return failed_;
+}
+
+uint64_t SpillStore::FirstLine() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return index_.empty() ? 0 : index_.front().first;
+}
+
+uint64_t SpillStore::EndLine() const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	return index_.empty() ? 0 : index_.back().first + index_.back().count;
+}
+
+std::shared_ptr<const char> SpillStore::Load(uint64_t line, uint64_t& first) const
+{
+	std::lock_guard<std::mutex> guard(lock_);
+	auto it = std::upper_bound(index_.begin(), index_.end(), line, [](uint64_t line, const IndexEntry& entry) {
+		return line < entry.first;
+	});
+	if (it == index_.begin())
+		return nullptr;
+	--it;
+	if (line >= it->first + it->count)
+		return nullptr;
+	auto segment = std::find_if(segments_.begin(), segments_.end(), [&](const Segment& segment) {
+		return segment.id == it->segment;
+	});
+	if (segment == segments_.end())
+		return nullptr;
+
+	// use a view we already have if it covers the chunk, the segment may have grown since it was mapped
+	int64_t end = it == index_.end() - 1 || (it + 1)->segment != it->segment ? segment->size : (it + 1)->offset;
+	auto mapped = std::find_if(mapped_.begin(), mapped_.end(), [&](const std::shared_ptr<MappedSegment>& mapped) {
+		return mapped->id == segment->id;
+	});
+	if (mapped != mapped_.end() && (*mapped)->size < end) {
+		mapped_.erase(mapped);
+		mapped = mapped_.end();
+	}
+	if (mapped == mapped_.end()) {
+		auto view = std::make_shared<MappedSegment>();
+		view->id = segment->id;
+		view->size = segment->size;
+		view->mapping = CreateFileMapping(segment->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (view->mapping)
+			view->view = static_cast<const char*>(MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, (SIZE_T)view->size));
+		if (view->view == nullptr) {
+			DLog("Cannot map spill segment %u for %s, err=%d\n", segment->id, name_.c_str(), (int)GetLastError());
+			return nullptr;
+		}
+		mapped_.push_front(view);
+		if (mapped_.size() > MaxMapped)
+			mapped_.pop_back();
+	}
+	else if (mapped != mapped_.begin())
+		mapped_.splice(mapped_.begin(), mapped_, mapped);
+
+	first = it->first;
+	auto view = mapped_.front();
+	return std::shared_ptr<const char>(view, view->view + it->offset);
+}
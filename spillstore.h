@@ -0,0 +1,73 @@
+#pragma once
+
+#include "utils.h"
+#include "logentry.h"
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Keeps the chunks that drop out of a log's buffer in segment files in the temp
+// directory, so the history can still be scrolled back through. The tailer
+// appends chunks as they're dropped, the views read them back in place through
+// memory mapped views of the segments, the most recently used few of which are
+// kept mapped. The segment files are deleted when they're closed.
+class SpillStore
+{
+	struct Segment
+	{
+		HANDLE file = INVALID_HANDLE_VALUE;
+		uint32_t id = 0;
+		int64_t size = 0;		// bytes written so far
+	};
+
+	// a chunk in a segment, one per chunk is enough to find any line quickly
+	struct IndexEntry
+	{
+		uint64_t first;			// line number of the first line in the chunk
+		uint32_t count;
+		uint32_t segment;
+		int64_t offset;
+	};
+
+	struct MappedSegment;
+
+	std::string name_;
+	uint32_t storeId_;			// logs in different directories can share a name
+	mutable std::mutex lock_;
+	std::deque<Segment> segments_;
+	std::deque<IndexEntry> index_;
+	int64_t totalBytes_ = 0;
+	uint32_t nextSegment_ = 0;
+	bool failed_ = false;
+	std::vector<char> scratch_;		// chunks are serialized here before they're written
+
+	// most recently used first
+	mutable std::list<std::shared_ptr<MappedSegment>> mapped_;
+
+public:
+	explicit SpillStore(const std::string& name);
+	~SpillStore();
+
+	SpillStore(const SpillStore&) = delete;
+	SpillStore& operator=(const SpillStore&) = delete;
+
+	// tailer only, chunks have to be appended in order
+	void Append(const LogChunk& chunk);
+
+	// the lines on disk are [FirstLine(), EndLine()), both are 0 if there aren't any
+	uint64_t FirstLine() const;
+	uint64_t EndLine() const;
+
+	// Finds the chunk a line is in, the block stays mapped for as long as it's held.
+	// Returns null if the line isn't on disk (any more).
+	std::shared_ptr<const char> Load(uint64_t line, uint64_t& first) const;
+
+	// a segment couldn't be created or written, so nothing more is spilled
+	bool Failed() const;
+
+private:
+	Segment* OpenSegment();
+	void DropOldestSegment();
+};
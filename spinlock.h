@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+class Spinlock
+{
+	// std::mutex will throw an exception when busy, so create a spinlock
+	// class based on atomic_flag::test_and_reset
+	std::atomic_flag& flag;
+public:
+	Spinlock(std::atomic_flag& lock) : flag(lock)
+	{
+		while (lock.test_and_set(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+	~Spinlock() { flag.clear(std::memory_order_release); }
+};
@@ -0,0 +1,140 @@
+#include "stuckview.h"
+#include <algorithm>
+
+StuckView::StuckView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector)
+	: ui_(ui), win_(win), collector_(collector)
+{
+}
+
+void StuckView::Init()
+{
+	SetPosition();
+}
+
+void StuckView::EnsureVisible()
+{
+	int visibleRows = win_->GetMaxY() - 1;
+	if (selectedIdx_ >= startRow_ + visibleRows)
+		startRow_ = selectedIdx_ - visibleRows + 1;
+	else if (startRow_ > selectedIdx_)
+		startRow_ = selectedIdx_;
+	if (startRow_ < 0)
+		startRow_ = 0;
+}
+
+bool StuckView::Update(int c)
+{
+	int pageSize = win_->GetMaxY() - 1;
+	switch (c) {
+	case KEY_DOWN:
+		if (selectedIdx_ < (int)stuck_.size() - 1) {
+			selectedIdx_++;
+			EnsureVisible();
+			return true;
+		}
+		break;
+
+	case KEY_UP:
+		if (selectedIdx_ > 0) {
+			selectedIdx_--;
+			EnsureVisible();
+			return true;
+		}
+		break;
+
+	case KEY_NPAGE: case ' ':
+		selectedIdx_ = std::max(std::min(selectedIdx_ + pageSize, (int)stuck_.size() - 1), 0);
+		EnsureVisible();
+		return true;
+
+	case KEY_PPAGE:
+		selectedIdx_ = std::max(selectedIdx_ - pageSize, 0);
+		EnsureVisible();
+		return true;
+	}
+
+	return false;
+}
+
+// how long a message is overdue, in hours and minutes once it's that long
+static std::string OverdueText(int64_t seconds)
+{
+	char text[32];
+	if (seconds < 60 * 60)
+		snprintf(text, sizeof(text), "%dm%02ds", (int)(seconds / 60), (int)(seconds % 60));
+	else
+		snprintf(text, sizeof(text), "%dh%02dm", (int)(seconds / 3600), (int)(seconds / 60 % 60));
+	return text;
+}
+
+void StuckView::Render()
+{
+	RefreshBuffer();
+	int maxy = win_->GetMaxY();
+	int maxx = win_->GetMaxX();
+
+	win_->AttrOn(COLOR_PAIR(LM_STATUS_BAR));
+	win_->PrintF(0, 0, maxx, "");
+	win_->PrintF(0, 2, 15, "Message Name");
+	win_->PrintF(0, 20, 15, "Waiting For");
+	win_->PrintF(0, 36, 15, "Overdue");
+	win_->PrintF(0, 50, 15, "Receiver Time");
+	win_->PrintF(0, 70, 15, "Engine Time");
+	win_->AttrOff(COLOR_PAIR(LM_STATUS_BAR));
+
+	int start = startRow_;
+	for (int y = 1; y < maxy; y++, start++) {
+		if (start >= (int)stuck_.size()) {
+			win_->Move(y, 0);
+			win_->ClearToEol();
+			continue;
+		}
+		const auto& stuck = stuck_[start];
+		const auto& msg = stuck.info;
+		if (selectedIdx_ == start)
+			win_->AttrOn(COLOR_PAIR(LM_ACTIVE));
+		win_->PrintF(y, 1, maxx, "");
+		win_->PrintF(y, 2, 15, "%s", msg->MessageName().c_str());
+		win_->PrintF(y, 20, 15, "%s", stuck.waiting == MessageFlow::engine ? "Engine" : "Sender");
+		win_->PrintF(y, 36, 15, "%s", OverdueText(stuck.overdue).c_str());
+		win_->PrintF(y, 50, 15, "%s", TimeText(msg->rxTime).c_str());
+		win_->PrintF(y, 70, 15, "%s", TimeText(msg->engTimeLatest).c_str());
+		win_->ClearToEol();
+		if (selectedIdx_ == start)
+			win_->AttrOff(COLOR_PAIR(LM_ACTIVE));
+	}
+
+	SetPosition();
+	win_->Touch();
+	win_->Refresh();
+}
+
+void StuckView::Resize()
+{
+	wresize(*win_, LINES - 4, COLS);
+	EnsureVisible();
+}
+
+void StuckView::RefreshBuffer()
+{
+	// stay on the same message as the list changes under it
+	uint64_t selected = selectedIdx_ < (int)stuck_.size() ? stuck_[selectedIdx_].info->messageId : 0;
+
+	collector_->GetStuck(stuck_);
+	std::sort(stuck_.begin(), stuck_.end(), [](const StuckMessage& lhs, const StuckMessage& rhs) {
+		return lhs.overdue > rhs.overdue;
+	});
+
+	auto it = std::find_if(stuck_.begin(), stuck_.end(), [&](const StuckMessage& stuck) { return stuck.info->messageId == selected; });
+	if (it != stuck_.end())
+		selectedIdx_ = (int)(it - stuck_.begin());
+	selectedIdx_ = std::max(std::min(selectedIdx_, (int)stuck_.size() - 1), 0);
+	EnsureVisible();
+}
+
+void StuckView::SetPosition()
+{
+	ui_->SetStatus(0, 0, "");
+	ui_->SetStatus(1, LM_STATUS_BAR, "  %d stuck messages", (int)stuck_.size());
+	ui_->SetStatus(2, LM_STATUS_BAR, "");
+}
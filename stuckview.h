@@ -0,0 +1,31 @@
+#pragma once
+
+#include "view.h"
+#include "messagecollector.h"
+#include "mainui.h"
+#include <vector>
+
+// the messages that have missed the deadline for their next stage, most overdue first
+class StuckView : public View
+{
+	MainUi* ui_;
+	std::shared_ptr<Window> win_;
+	MessageCollectorPtr collector_;
+	std::vector<StuckMessage> stuck_;
+
+public:
+	StuckView(MainUi* ui, std::shared_ptr<Window> win, MessageCollectorPtr collector);
+
+	virtual void Init();
+	virtual bool Update(int c);
+	virtual void Render();
+	virtual void Resize();
+
+private:
+	int startRow_ = 0;
+	int selectedIdx_ = 0;
+
+	void RefreshBuffer();
+	void EnsureVisible();
+	void SetPosition();
+};
@@ -0,0 +1,831 @@
+// Rough numbers for the changes that were made for speed, run it before and after
+// touching one of these. With no arguments it runs them all, otherwise the ones named.
+#include "boundedqueue.h"
+#include "controllerline.h"
+#include "linereader.h"
+#include "flatmap.h"
+#include "logtime.h"
+#include "messagecollector.h"
+#include "messageid.h"
+#include "messagescanner.h"
+#include "seqring.h"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/regex.hpp>
+#include <boost/signals2/signal.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include "mappedfile.h"
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// the app's DLog isn't linked in, and the collector logs every message it expires
+void DLog(const char*, ...)
+{
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static volatile uint64_t sink;	// keeps the work from being optimised away
+
+template<class F>
+static double Seconds(F&& f)
+{
+	auto start = Clock::now();
+	f();
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void Report(const char* what, double seconds, double count, const char* unit)
+{
+	printf("%-44s %10.2f M%s/s\n", what, count / seconds / 1e6, unit);
+}
+
+// size of the generated log the file benchmarks read, set with -mb
+static size_t fileMegabytes = 256;
+
+// An MMEngine style line, "tid HH:MM:SS.mmm body" and now and then a continuation
+// line, a tab or a long script dump, returns its length with the "\r\n"
+static int EngineLine(std::mt19937& rng, uint64_t i, char (&line)[512])
+{
+	int ms = (int)(i * 7 % MsPerDay);
+	int n;
+	switch (rng() % 20) {
+	case 0:
+		return snprintf(line, sizeof(line), "\tat line %u of the category script\r\n", (unsigned)rng() % 1000);
+	case 1:
+		return snprintf(line, sizeof(line), "%u %s Rule \"%s\" matched, running actions\t(%u ms)\r\n", 1000 + (unsigned)rng() % 64,
+			TimeText(ms).c_str(), "Block executables in archives", (unsigned)rng() % 50);
+	case 2:
+		n = snprintf(line, sizeof(line), "%u %s Script output: ", 1000 + (unsigned)rng() % 64, TimeText(ms).c_str());
+		while (n < 440)
+			n += snprintf(line + n, sizeof(line) - n, "variable%u=%u; ", (unsigned)rng() % 100, (unsigned)rng());
+		return n + snprintf(line + n, sizeof(line) - n, "\r\n");
+	default:
+		return snprintf(line, sizeof(line), "%u %s Processing B%012llX.0123456789ab.cdef.mml for %u recipients\r\n",
+			1000 + (unsigned)rng() % 64, TimeText(ms).c_str(), (unsigned long long)(i / 4), 1 + (unsigned)rng() % 5);
+	}
+}
+
+// A log of them, written once and removed when the benchmarks finish. They read
+// it from the page cache, so it's the cost of getting lines out of the file that's
+// measured rather than the disk.
+static std::string engineLog;
+
+static std::string EngineLog()
+{
+	auto& path = engineLog;
+	if (!path.empty())
+		return path;
+	const char* dir = getenv("TMPDIR");
+	if (dir == nullptr)
+		dir = getenv("TEMP");
+	path = std::string(dir != nullptr ? dir : "/tmp") + "/mlog_bench_engine.log";
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (fp == nullptr) {
+		fprintf(stderr, "can't create %s\n", path.c_str());
+		exit(1);
+	}
+	std::mt19937 rng(4);
+	size_t written = 0;
+	char line[512];
+	for (uint64_t i = 0; written < fileMegabytes << 20; i++) {
+		int n = EngineLine(rng, i, line);
+		fwrite(line, 1, n, fp);
+		written += n;
+	}
+	fclose(fp);
+	return path;
+}
+
+// The tailer's old loop, a character at a time through fgetc into a std::string,
+// against LineReader's blocks and memchr, both just handing the lines over.
+static void Lines()
+{
+	auto path = EngineLog();
+	double size = (double)(fileMegabytes << 20);
+	uint64_t lines = 0, bytes = 0;
+
+	FILE* fp = fopen(path.c_str(), "rb");
+	LineReader reader;
+	auto onLine = [&](const char* line, size_t len) {
+		lines++;
+		bytes += len + (line[0] == '\t');
+	};
+	double blocks = Seconds([&]() {
+		while (reader.Read(fp, onLine) > 0) {
+		}
+	});
+	fclose(fp);
+	Report("LineReader", blocks, size, "B");
+
+	fp = fopen(path.c_str(), "rb");
+	double chars = Seconds([&]() {
+		std::string line;
+		for (int c = fgetc(fp); c != EOF; c = fgetc(fp)) {
+			if (c == '\t')
+				line += "    ";
+			else
+				line += (char)c;
+			if (c == '\n') {
+				onLine(line.data(), line.size());
+				line.clear();
+			}
+		}
+	});
+	fclose(fp);
+	Report("fgetc into a std::string", chars, size, "B");
+	sink = lines + bytes;
+}
+
+// How the backfill gets at the file: stdio blocks (the old path), plain read()
+// blocks, and 4 MB views of a mapping (what MappedFile does), all split with
+// LineReader so only the way the bytes arrive differs. Warm is the file straight
+// from the page cache; on POSIX the cold runs evict it with fadvise first, so they
+// include the disk.
+static const size_t ReadBlock = 1024 * 1024;
+static const size_t ViewBytes = 4 * 1024 * 1024;
+
+static void Evict(const std::string& path)
+{
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)path;
+#endif
+}
+
+static void ReadStdio(const std::string& path, LineReader& reader, uint64_t& lines)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	while (reader.Read(fp, [&](const char*, size_t) { lines++; }) > 0) {
+	}
+	fclose(fp);
+}
+
+static void ReadBlocks(const std::string& path, LineReader& reader, uint64_t& lines)
+{
+	std::vector<char> buf(ReadBlock);
+#ifdef _WIN32
+	int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+	for (int n; (n = _read(fd, buf.data(), (unsigned)buf.size())) > 0;)
+		reader.Split(buf.data(), n, [&](const char*, size_t) { lines++; });
+	_close(fd);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	for (ssize_t n; (n = read(fd, buf.data(), buf.size())) > 0;)
+		reader.Split(buf.data(), n, [&](const char*, size_t) { lines++; });
+	close(fd);
+#endif
+}
+
+static void ReadMapped(const std::string& path, LineReader& reader, uint64_t& lines)
+{
+#ifdef _WIN32
+	MappedFile file;
+	file.Open(path);
+	for (int64_t offset = 0; file.Map(offset, ViewBytes); offset += file.Length())
+		reader.Split(file.Data(), file.Length(), [&](const char*, size_t) { lines++; });
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	fstat(fd, &st);
+	for (off_t offset = 0; offset < st.st_size; offset += ViewBytes) {
+		size_t length = (size_t)std::min<off_t>(ViewBytes, st.st_size - offset);
+		void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, offset);
+		// the advice values aren't flags, so one call each
+		madvise(view, length, MADV_SEQUENTIAL);
+		madvise(view, length, MADV_WILLNEED);
+		reader.Split(static_cast<const char*>(view), length, [&](const char*, size_t) { lines++; });
+		munmap(view, length);
+	}
+	close(fd);
+#endif
+}
+
+static void FileReads()
+{
+	auto path = EngineLog();
+	double size = (double)(fileMegabytes << 20);
+	static const struct
+	{
+		const char* name;
+		void (*read)(const std::string&, LineReader&, uint64_t&);
+	} Ways[] = {
+		{ "stdio", ReadStdio },
+		{ "read", ReadBlocks },
+		{ "mapped", ReadMapped },
+	};
+
+	uint64_t lines = 0;
+	for (bool cold : { false, true }) {
+#ifdef _WIN32
+		if (cold)
+			break;
+#endif
+		for (const auto& way : Ways) {
+			LineReader reader;
+			char what[64];
+			snprintf(what, sizeof(what), "%s, %s", way.name, cold ? "cold" : "warm");
+			if (cold)
+				Evict(path);
+			else
+				way.read(path, reader, lines);	// make sure it's all in the cache
+			Report(what, Seconds([&]() { way.read(path, reader, lines); }), size, "B");
+		}
+	}
+	sink = lines;
+}
+
+// LogFile::Backfill without the Win32 around it: the file in 4 MB chunks that
+// start at a line, parsed into LogChunks on a pool of threads no more than two
+// chunks each ahead of the merge, and merged back in order on this thread. The
+// target is a GB of Engine logs in a few seconds on 8 cores, run it with -mb 1024.
+static void Backfill()
+{
+	auto path = EngineLog();
+	size_t size = fileMegabytes << 20;
+#ifdef _WIN32
+	MappedFile file;
+	file.Open(path);
+	file.Map(0, size);
+	const char* data = file.Data();
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	auto data = static_cast<const char*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+	madvise(const_cast<char*>(data), size, MADV_SEQUENTIAL);
+#endif
+
+	const size_t ChunkSize = 4 * 1024 * 1024;
+	auto parse = [&](size_t begin, size_t end, std::vector<LogChunkPtr>& lines) {
+		const char* p = data + begin;
+		const char* last = data + size;
+		if (begin > 0 && p[-1] != '\n')
+			p = static_cast<const char*>(memchr(p, '\n', last - p)) + 1;
+		LogEntry entry;
+		std::string scratch;
+		while (p < data + end) {
+			auto nl = static_cast<const char*>(memchr(p, '\n', last - p));
+			const char* line = p;
+			size_t len = (nl ? nl : last) - p;
+			if (len > 0 && line[len - 1] == '\r')
+				len--;
+			p = nl ? nl + 1 : last;
+			if (memchr(line, '\t', len) != nullptr) {
+				scratch.clear();
+				for (const char* c = line; c < line + len; c++) {
+					if (*c == '\t')
+						scratch += "    ";
+					else
+						scratch += *c;
+				}
+				line = scratch.data(), len = scratch.size();
+			}
+			entry.Clear();
+			if (!ParseControllerLine(line, len, entry)) {
+				entry.type = MessageType::continuation;
+				entry.body.assign(line, len);
+			}
+			if (lines.empty() || !lines.back()->Append(entry)) {
+				lines.push_back(std::make_shared<LogChunk>(0, 16 * 1024, std::max<uint32_t>(1024 * 1024, LogChunk::BytesNeeded(entry))));
+				lines.back()->Append(entry);
+			}
+		}
+	};
+
+	for (unsigned threads : { 1, 2, 4, 8 }) {
+		size_t numChunks = (size + ChunkSize - 1) / ChunkSize;
+		std::vector<std::vector<LogChunkPtr>> chunks(numChunks);
+		std::vector<char> done(numChunks);
+		std::mutex lock;
+		std::condition_variable cv;
+		size_t next = 0, merged = 0;
+		size_t window = threads * 2;
+		uint64_t lines = 0;
+
+		double seconds = Seconds([&]() {
+			auto worker = [&]() {
+				for (;;) {
+					size_t i;
+					{
+						std::unique_lock<std::mutex> guard(lock);
+						cv.wait(guard, [&]() { return next >= numChunks || next < merged + window; });
+						if (next >= numChunks)
+							return;
+						i = next++;
+					}
+					parse(i * ChunkSize, std::min(size, (i + 1) * ChunkSize), chunks[i]);
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						done[i] = 1;
+					}
+					cv.notify_all();
+				}
+			};
+			std::vector<std::thread> pool;
+			for (unsigned i = 0; i < threads; i++)
+				pool.emplace_back(worker);
+
+			LogEntry entry;
+			for (size_t i = 0; i < numChunks; i++) {
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					cv.wait(guard, [&]() { return done[i] != 0; });
+				}
+				for (const auto& chunk : chunks[i]) {
+					for (size_t j = 0; j < chunk->Count(); j++) {
+						chunk->Get(j).CopyTo(entry);
+						lines++;
+					}
+				}
+				chunks[i].clear();
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					merged = i + 1;
+				}
+				cv.notify_all();
+			}
+			for (auto& thread : pool)
+				thread.join();
+		});
+		char what[64];
+		snprintf(what, sizeof(what), "backfill, %u threads (%.2f s per GB)", threads, seconds * 1024 / fileMegabytes);
+		Report(what, seconds, (double)size, "B");
+		sink = lines;
+	}
+
+#ifndef _WIN32
+	munmap(const_cast<char*>(data), size);
+	close(fd);
+#endif
+}
+
+// The controller line format parsed by hand against LogFile's regex, which took
+// the tid, time and body out of the match as strings, both into a reused entry
+static void ControllerLines()
+{
+	std::mt19937 rng(6);
+	std::vector<std::string> lines;
+	char line[512];
+	for (int i = 0; i < 100000; i++) {
+		int n = EngineLine(rng, i, line);
+		lines.emplace_back(line, n - 2);
+	}
+
+	LogEntry entry;
+	uint64_t total = 0;
+	double parsed = Seconds([&]() {
+		for (int r = 0; r < 10; r++) {
+			for (auto& text : lines)
+				total += ParseControllerLine(text.data(), text.size(), entry) ? entry.time : 0;
+		}
+	});
+	Report("ParseControllerLine", parsed, 10.0 * lines.size(), "lines");
+
+	static const boost::regex pattern("^(\\d+)\\s(\\d{2}:\\d{2}:\\d{2}\\.\\d{3})\\s(.*)$");
+	double matched = Seconds([&]() {
+		boost::cmatch match;
+		for (auto& text : lines) {
+			if (boost::regex_search(text.data(), text.data() + text.size(), match, pattern, boost::match_single_line)) {
+				entry.tid = atoi(match.str(1).c_str());
+				entry.time = ParseTimeOfDay(match.str(2).c_str());
+				entry.body = match.str(3);
+				total += entry.time;
+			}
+		}
+	});
+	Report("boost::regex and the groups as strings", matched, (double)lines.size(), "lines");
+	sink = total;
+}
+
+// Handing parsed entries to the subscribers, a signals2 emit for every entry as
+// it was before, against LogFile's way of copying them into a reused pending
+// vector and emitting a LogEntrySpan for a read's worth. A shared_ptr stands in for
+// the LogFilePtr that goes with each emit, two slots stand in for the collector's
+// dispatcher and a view.
+static void Signals()
+{
+	std::mt19937 rng(7);
+	std::vector<LogEntry> parsed(100000);
+	char line[512];
+	for (size_t i = 0; i < parsed.size(); i++) {
+		int n = EngineLine(rng, i, line);
+		if (!ParseControllerLine(line, n - 2, parsed[i]))
+			parsed[i].body.assign(line, n - 2);
+	}
+	auto file = std::make_shared<int>(0);
+	const int Rounds = 10;
+	uint64_t total = 0;
+
+	boost::signals2::signal<void(std::shared_ptr<int>, const LogEntry&)> perEntry;
+	for (int i = 0; i < 2; i++)
+		perEntry.connect([&](std::shared_ptr<int>, const LogEntry& entry) { total += entry.body.size(); });
+	double each = Seconds([&]() {
+		for (int r = 0; r < Rounds; r++) {
+			for (auto& entry : parsed)
+				perEntry(file, entry);
+		}
+	});
+	Report("signals2, an emit per entry", each, (double)Rounds * parsed.size(), "entries");
+
+	boost::signals2::signal<void(std::shared_ptr<int>, const LogEntrySpan&)> perSpan;
+	for (int i = 0; i < 2; i++) {
+		perSpan.connect([&](std::shared_ptr<int>, const LogEntrySpan& span) {
+			for (auto& entry : span)
+				total += entry.body.size();
+		});
+	}
+	// 700 is about what one 64 KB read of an Engine log holds, 4096 is LogFile's cap
+	for (size_t batch : { 16, 700, 4096 }) {
+		std::vector<LogEntry> pending(batch);
+		size_t numPending = 0;
+		double spans = Seconds([&]() {
+			for (int r = 0; r < Rounds; r++) {
+				for (auto& entry : parsed) {
+					pending[numPending++] = entry;
+					if (numPending == batch) {
+						perSpan(file, LogEntrySpan(pending.data(), numPending));
+						numPending = 0;
+					}
+				}
+			}
+		});
+		char what[64];
+		snprintf(what, sizeof(what), "signals2, copied into spans of %u", (unsigned)batch);
+		Report(what, spans, (double)Rounds * parsed.size(), "entries");
+	}
+	sink = total;
+}
+
+// Lines made up to look like the receiver's, most of them don't mention a message.
+// It's a synthetic mix rather than recorded traffic, there's no capture of a real
+// log in the tree, so the speed up on a real log will differ with its mix.
+static std::vector<std::string> ReceiverLines()
+{
+	std::mt19937 rng(1);
+	std::vector<std::string> lines;
+	for (int i = 0; i < 100000; i++) {
+		char line[160];
+		if (i % 50 == 0)
+			snprintf(line, sizeof(line), "TX: <250 B%012X Message accepted for delivery>", i);
+		else if (i % 50 == 1)
+			snprintf(line, sizeof(line), "B%012X.0123456789ab.cdef.mml SpamProfiler score: %d, rescan: 0, bulk: 0", i, (int)(rng() % 100));
+		else if (i % 10 == 0)
+			snprintf(line, sizeof(line), "Delivering B%012X.0123456789ab.cdef.mml to remote host mail.example.com", i);
+		else if (i % 3 == 0)
+			snprintf(line, sizeof(line), "RX: MAIL FROM:<user%u@example.com> SIZE=%u", (unsigned)rng() % 1000, (unsigned)rng() % 100000);
+		else
+			snprintf(line, sizeof(line), "Processing connection from 10.0.%u.%u state %u", (unsigned)rng() % 255, (unsigned)rng() % 255, (unsigned)rng());
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+// the scanner against the three boost patterns it replaced, tried in the same order
+static void Scanner()
+{
+	auto lines = ReceiverLines();
+	uint64_t found = 0;
+	double scanned = Seconds([&]() {
+		for (int r = 0; r < 10; r++) {
+			for (auto& line : lines)
+				found += ScanReceiverLine(line.data(), line.size()).messageId;
+		}
+	});
+	Report("ScanReceiverLine", scanned, 10.0 * lines.size(), "lines");
+
+	static const boost::regex arrivePattern("^TX:\\s<250\\s(\\w+)\\sMessage\\saccepted\\sfor\\sdelivery>$");
+	static const boost::regex spamProfilerPattern("^([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml\\sSpamProfiler\\sscore:\\s(\\d+),\\srescan:\\s(\\d+),\\sbulk:\\s(\\d+)");
+	static const boost::regex msgPattern("([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml");
+	double matched = Seconds([&]() {
+		boost::smatch match;
+		for (auto& line : lines) {
+			if (boost::regex_search(line, match, arrivePattern, boost::match_default)
+				|| boost::regex_search(line, match, spamProfilerPattern, boost::match_default)
+				|| boost::regex_search(line, match, msgPattern, boost::match_default))
+				found += PackMessageId(match[1].str());
+		}
+	});
+	Report("boost::regex, the receiver's three patterns", matched, (double)lines.size(), "lines");
+
+	// the engine and sender only look for a message file name
+	double engine = Seconds([&]() {
+		for (int r = 0; r < 10; r++) {
+			for (auto& line : lines)
+				found += FindMessageId(line.data(), line.size());
+		}
+	});
+	Report("FindMessageId", engine, 10.0 * lines.size(), "lines");
+	double engineMatched = Seconds([&]() {
+		boost::smatch match;
+		for (auto& line : lines) {
+			if (boost::regex_search(line, match, msgPattern, boost::match_default))
+				found += PackMessageId(match[1].str());
+		}
+	});
+	Report("boost::regex, the message pattern", engineMatched, (double)lines.size(), "lines");
+	sink = found;
+}
+
+// the times as they were kept before, as text turned into a duration by boost
+static void TimeOfDay()
+{
+	std::vector<std::string> times;
+	for (int i = 0; i < 100000; i++)
+		times.push_back(TimeText(i * 863).c_str());
+
+	int64_t total = 0;
+	double parsed = Seconds([&]() {
+		for (int r = 0; r < 100; r++) {
+			for (auto& text : times)
+				total += ParseTimeOfDay(text.c_str());
+		}
+	});
+	Report("ParseTimeOfDay", parsed, 100.0 * times.size(), "times");
+
+	double converted = Seconds([&]() {
+		for (auto& text : times) {
+			try {
+				total += boost::posix_time::duration_from_string(text).total_milliseconds();
+			}
+			catch (std::exception&) {
+			}
+		}
+	});
+	Report("posix_time::duration_from_string", converted, (double)times.size(), "times");
+	sink = (uint64_t)total;
+}
+
+// Looking up the message a line is about, with as many tracked as the collector
+// holds by default. The names are found in the line, so the map keyed on them had
+// to be given a std::string made from it each time, the packed id is made in place.
+static void Maps()
+{
+	const int Count = 100000;
+	std::mt19937 rng(2);
+	const char Digits[] = "0123456789abcdef";
+	std::vector<std::string> lines;
+	for (int i = 0; i < Count; i++) {
+		std::string name(1, (char)('A' + rng() % 5));
+		for (int j = 0; j < 12; j++)
+			name += Digits[rng() % 16];
+		lines.push_back("Delivering " + name + ".0123456789ab.cdef.mml");
+	}
+	const size_t At = 11;	// where the name is in the line
+
+	uint64_t total = 0;
+	FlatMap<uint64_t> flat;
+	for (auto& line : lines)
+		flat[PackMessageId(line.data() + At)] = 1;
+	double flatTime = Seconds([&]() {
+		for (int r = 0; r < 10; r++) {
+			for (auto& line : lines)
+				total += *flat.Find(PackMessageId(line.data() + At));
+		}
+	});
+	Report("FlatMap on packed ids, 100k tracked", flatTime, 10.0 * Count, "lookups");
+
+	std::map<std::string, std::shared_ptr<uint64_t>> named;
+	for (auto& line : lines)
+		named[line.substr(At, MessageNameLength)] = std::make_shared<uint64_t>(1);
+	double namedTime = Seconds([&]() {
+		for (int r = 0; r < 10; r++) {
+			for (auto& line : lines)
+				total += *named.find(std::string(line.data() + At, MessageNameLength))->second;
+		}
+	});
+	Report("std::map on names, 100k tracked", namedTime, 10.0 * Count, "lookups");
+	sink = total;
+}
+
+// The collector parsing the three logs on their own threads the way the feed hands
+// them over, 64 lines at a time. The writers share messages, each with the two after
+// it under a different log type, and there are few enough kept that they expire.
+// Only one writer for each type runs in the viewer, more show how the shards scale.
+static void Collector()
+{
+	const int Lines = 1200000;
+	for (int writers : { 1, 2, 4, 8 }) {
+		MessageLimits limits;
+		limits.maxMessages = 8192;
+		MessageCollector collector(limits);
+
+		std::vector<std::vector<LogEntry>> lines(writers);
+		for (int w = 0; w < writers; w++) {
+			std::mt19937 rng(w);
+			for (int i = 0; i < Lines / writers; i++) {
+				char name[16];
+				snprintf(name, sizeof(name), "B%012llX", (unsigned long long)(1 + rng() % 20000));
+				LogEntry entry;
+				entry.day = 20000;
+				entry.time = i % MsPerDay;
+				switch (w % 3) {
+				case 0:
+					entry.body = std::string("TX: <250 ") + name + " Message accepted for delivery>";
+					break;
+				case 1:
+					entry.body = std::string("Processing ") + name + ".0123456789ab.cdef.mml";
+					break;
+				default:
+					entry.body = std::string("Sent ") + name + ".0123456789ab.cdef.mml";
+					break;
+				}
+				lines[w].push_back(std::move(entry));
+			}
+		}
+
+		double seconds = Seconds([&]() {
+			std::vector<std::thread> threads;
+			for (int w = 0; w < writers; w++) {
+				threads.emplace_back([&, w]() {
+					auto logType = (MessageCollector::LogType)(w % 3);
+					for (size_t i = 0; i < lines[w].size(); i += 64)
+						collector.Parse(logType, LogEntrySpan(&lines[w][i], std::min<size_t>(64, lines[w].size() - i)));
+				});
+			}
+			for (auto& thread : threads)
+				thread.join();
+		});
+		char what[64];
+		snprintf(what, sizeof(what), "MessageCollector, %d writers", writers);
+		Report(what, seconds, (double)Lines, "lines");
+		sink = collector.NumMessages();
+	}
+
+	// the message view's refresh with a full table, a few messages changing and
+	// expiring between each, it should cost what changed rather than the table
+	MessageLimits limits;
+	limits.maxMessages = 100000;
+	MessageCollector collector(limits);
+	std::vector<LogEntry> lines;
+	for (uint64_t i = 0; i < 400000; i++) {
+		LogEntry entry;
+		entry.day = 20000;
+		entry.time = (int)(i % MsPerDay);
+		char body[64];
+		snprintf(body, sizeof(body), "Processing B%012llX.0123456789ab.cdef.mml", (unsigned long long)(1 + i % 150000));
+		entry.body = body;
+		lines.push_back(std::move(entry));
+	}
+	collector.Parse(MessageCollector::LogType::engine, LogEntrySpan(lines.data(), 100000));
+	MessageList list;
+	collector.FillBuffer(list);
+	const size_t Changes = 16;
+	size_t next = 100000;
+	double refreshes = Seconds([&]() {
+		for (; next + Changes <= lines.size(); next += Changes) {
+			collector.Parse(MessageCollector::LogType::engine, LogEntrySpan(&lines[next], Changes));
+			collector.FillBuffer(list);
+		}
+	});
+	double count = (double)(lines.size() - 100000) / Changes;
+	char what[64];
+	snprintf(what, sizeof(what), "FillBuffer, 100k kept, 16 changed (%.1f us)", refreshes / count * 1e6);
+	Report(what, refreshes, count, "refreshes");
+	sink = list.size();
+}
+
+// the tailer handing lines to a subscriber's thread through its queue, one line at
+// a time or 64 at a time the way a flush hands them over
+static void Queue()
+{
+	const int Lines = 2000000;
+	for (int batch : { 1, 64 }) {
+		BoundedQueue<std::vector<uint64_t>> queue(1024);
+		uint64_t total = 0;
+		double elapsed = Seconds([&]() {
+			std::thread consumer([&]() {
+				int received = 0;
+				std::vector<uint64_t> lines;
+				while (received < Lines) {
+					if (!queue.TryPop(lines)) {
+						std::this_thread::yield();
+						continue;
+					}
+					for (auto line : lines)
+						total += line;
+					received += (int)lines.size();
+				}
+			});
+			for (int i = 0; i < Lines; i += batch) {
+				std::vector<uint64_t> lines(batch, (uint64_t)i);
+				while (!queue.TryPush(lines))
+					std::this_thread::yield();
+			}
+			consumer.join();
+		});
+		Report(batch == 1 ? "BoundedQueue, a line at a time" : "BoundedQueue, 64 lines at a time", elapsed, Lines, "lines");
+		sink = total;
+	}
+}
+
+// readers going over the whole ring while the writer keeps pushing, how many
+// lines they get through doesn't drop as more of them are added
+static void Ring()
+{
+	for (int readers : { 1, 2, 4, 8 }) {
+		SeqRing<uint64_t> ring(4096);
+		for (uint64_t i = 0; i < 4096; i++)
+			ring.Push(std::make_shared<uint64_t>(i));
+		std::atomic<bool> done(false);
+		std::atomic<uint64_t> read(0);
+		std::vector<std::thread> threads;
+		for (int r = 0; r < readers; r++) {
+			threads.emplace_back([&]() {
+				uint64_t count = 0, total = 0;
+				while (!done) {
+					SeqRing<uint64_t>::Reader reader(ring);
+					for (uint64_t seq = reader.Tail(); seq < reader.Head(); seq++) {
+						if (auto item = reader.Get(seq)) {
+							total += *item;
+							count++;
+						}
+					}
+				}
+				read += count;
+				sink = total;
+			});
+		}
+		uint64_t pushed = 0;
+		double elapsed = Seconds([&]() {
+			auto until = Clock::now() + std::chrono::milliseconds(500);
+			for (uint64_t i = 4096; Clock::now() < until; i++, pushed++) {
+				ring.Push(std::make_shared<uint64_t>(i));
+				ring.Drop();
+			}
+			done = true;
+			for (auto& thread : threads)
+				thread.join();
+		});
+		char what[64];
+		snprintf(what, sizeof(what), "SeqRing, %d readers", readers);
+		Report(what, elapsed, (double)read.load(), "reads");
+		snprintf(what, sizeof(what), "SeqRing, writer against %d readers", readers);
+		Report(what, elapsed, (double)pushed, "pushes");
+	}
+}
+
+static const struct
+{
+	const char* name;
+	void (*run)();
+} Benches[] = {
+	{ "time", TimeOfDay },
+	{ "lines", Lines },
+	{ "read", FileReads },
+	{ "backfill", Backfill },
+	{ "controller", ControllerLines },
+	{ "signals", Signals },
+	{ "map", Maps },
+	{ "scanner", Scanner },
+	{ "collector", Collector },
+	{ "queue", Queue },
+	{ "seqring", Ring },
+};
+
+int main(int argc, char** argv)
+{
+	std::vector<const char*> names;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+			fileMegabytes = (size_t)atoi(argv[++i]);
+		else
+			names.push_back(argv[i]);
+	}
+
+	for (const auto& bench : Benches) {
+		bool wanted = names.empty();
+		for (auto name : names)
+			wanted = wanted || strcmp(name, bench.name) == 0;
+		if (wanted)
+			bench.run();
+	}
+	if (!engineLog.empty())
+		remove(engineLog.c_str());
+	return 0;
+}
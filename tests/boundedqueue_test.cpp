@@ -0,0 +1,69 @@
+#include "boundedqueue.h"
+#include "check.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void Basics()
+{
+	BoundedQueue<int> queue(5);
+	CHECK(queue.Capacity() == 8);
+	for (int i = 0; i < 8; i++)
+		CHECK(queue.TryPush(i));
+	int value = 99;
+	CHECK(!queue.TryPush(value) && value == 99);
+	for (int i = 0; i < 8; i++)
+		CHECK(queue.TryPop(value) && value == i);
+	CHECK(!queue.TryPop(value));
+}
+
+// several producers and consumers, every value comes out exactly once and each
+// producer's values come out in the order it pushed them
+static void Stress(int producers, int consumers, int perProducer)
+{
+	BoundedQueue<uint64_t> queue(64);
+	std::vector<std::atomic<int>> taken(producers * perProducer);
+	for (auto& count : taken)
+		count = 0;
+	std::atomic<int> popped(0);
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&, p]() {
+			for (int i = 0; i < perProducer; i++) {
+				uint64_t value = (uint64_t)p << 32 | (uint64_t)i;
+				while (!queue.TryPush(value))
+					std::this_thread::yield();
+			}
+		});
+	}
+	for (int c = 0; c < consumers; c++) {
+		threads.emplace_back([&]() {
+			std::vector<int> last(producers, -1);
+			while (popped < producers * perProducer) {
+				uint64_t value;
+				if (!queue.TryPop(value)) {
+					std::this_thread::yield();
+					continue;
+				}
+				int p = (int)(value >> 32), i = (int)(value & 0xffffffff);
+				CHECK(i > last[p]);
+				last[p] = i;
+				taken[p * perProducer + i]++;
+				popped++;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	for (auto& count : taken)
+		CHECK(count == 1);
+}
+
+int main()
+{
+	Basics();
+	Stress(1, 1, 200000);
+	Stress(4, 4, 50000);
+	printf("boundedqueue: ok\n");
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "controllerline.h"
+#include "check.h"
+#include <boost/regex.hpp>
+#include <random>
+
+// LogFile's pattern for the controller logs, the fast path has to agree with it
+static const boost::regex pattern("^(\\d+)\\s(\\d{2}:\\d{2}:\\d{2}\\.\\d{3})\\s(.*)$");
+
+static void Compare(const std::string& line, int& parsed)
+{
+	LogEntry entry;
+	bool fast = ParseControllerLine(line.data(), line.size(), entry);
+	boost::cmatch match;
+	bool matched = boost::regex_search(line.data(), line.data() + line.size(), match, pattern, boost::match_single_line);
+	if (fast) {
+		parsed++;
+		CHECK(matched);
+		CHECK(entry.type == MessageType::normal);
+		CHECK(TimeText(entry.time).c_str() == match.str(2));
+		CHECK(entry.body == match.str(3));
+		if (match.length(1) <= 9)
+			CHECK(entry.tid == atoi(match.str(1).c_str()));
+	}
+	else if (matched) {
+		// it only leaves the regex the times that aren't times of day, LogFile
+		// then gives those lines no time
+		if (ParseTimeOfDay(match[2].first) >= 0)
+			fprintf(stderr, "rejected: %s\n", line.c_str());
+		CHECK(ParseTimeOfDay(match[2].first) < 0);
+	}
+}
+
+int main()
+{
+	int parsed = 0;
+	for (const char* line : {
+		"1234 12:34:56.789 Processing B5f3e6c1a0d42.0123456789ab.cdef.mml",
+		"1 00:00:00.000 ",
+		"1 00:00:00.000 \t",
+		"1\t23:59:59.999\tbody with\ttabs",
+		"01234567890123 12:00:00.000 a tid longer than an int",
+		"\tat line 12 of the category script",	// a continuation line
+		"    continued",
+		"",
+		"1234",
+		"1234 12:34:56.789",			// no space after the time
+		"1234 12:34:56.789x",
+		"1234  12:34:56.789 two spaces",
+		"1234 2:34:56.789 short hour",
+		"1234 12:34:56,789 comma",
+		"1234 24:00:00.000 out of range",
+		"1234 12:60:00.000 out of range",
+		"1234 12:34:56.789\r",			// \s takes the \r, an empty body
+		"-12 12:34:56.789 negative",
+		"12a 12:34:56.789 letter in the tid",
+		"2024-02-29 12:34:56.789 [a] [b] config service format",
+	})
+		Compare(line, parsed);
+	CHECK(parsed == 6);
+
+	// lines put together as tid, space, time, space and body, each part usually good
+	// and now and then something that breaks it
+	std::mt19937 rng(5);
+	auto pick = [&](const std::vector<std::string>& good, const std::vector<std::string>& bad) {
+		return rng() % 4 != 0 ? good[rng() % good.size()] : bad[rng() % bad.size()];
+	};
+	const std::vector<std::string> tids = { "1234", "7", "0", "4294967295" }, badTids = { "", "-1", "12a", "x", " 12" };
+	const std::vector<std::string> spaces = { " ", "\t", "\r", "\f" }, badSpaces = { "", "  ", "x", ":" };
+	const std::vector<std::string> times = { "12:34:56.789", "23:59:59.999", "00:00:00.000" },
+		badTimes = { "24:00:00.000", "99:99:99.999", "12:34:56", "1:23:45.678", "12:34:56,789", "12:3a:56.789", "12:34:56.78" };
+	const std::vector<std::string> bodies = { "", "Processing", "body text", "\ttabbed", "12:34:56.789 again", "\r" }, badBodies = { "\n" };
+	for (int i = 0; i < 200000; i++) {
+		std::string line = pick(tids, badTids) + pick(spaces, badSpaces) + pick(times, badTimes) + pick(spaces, badSpaces)
+			+ pick(bodies, badBodies);
+		Compare(line, parsed);
+	}
+	printf("controllerline: %d of the lines parsed, ok\n", parsed);
+	return 0;
+}
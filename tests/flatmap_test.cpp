@@ -0,0 +1,41 @@
+#include "flatmap.h"
+#include "check.h"
+#include <random>
+#include <unordered_map>
+
+// random inserts, lookups and erases against std::unordered_map, erasing shifts
+// entries back so it's the part most worth checking
+int main()
+{
+	std::mt19937_64 rng(1);
+	FlatMap<uint64_t> map;
+	std::unordered_map<uint64_t, uint64_t> model;
+	for (int i = 0; i < 1000000; i++) {
+		uint64_t key = 1 + rng() % 5000;
+		switch (rng() % 3) {
+		case 0:
+			map[key] = key * 3;
+			model[key] = key * 3;
+			break;
+		case 1:
+			CHECK(map.Erase(key) == (model.erase(key) == 1));
+			break;
+		case 2: {
+			auto found = map.Find(key);
+			auto it = model.find(key);
+			CHECK((found != nullptr) == (it != model.end()));
+			CHECK(found == nullptr || *found == it->second);
+			break;
+		}
+		}
+		CHECK(map.size() == model.size());
+	}
+	size_t count = 0;
+	map.ForEach([&](uint64_t key, uint64_t value) {
+		CHECK(model.at(key) == value);
+		count++;
+	});
+	CHECK(count == model.size());
+	printf("flatmap: ok\n");
+	return 0;
+}
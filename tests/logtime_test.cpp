@@ -0,0 +1,25 @@
+#include "logtime.h"
+#include "check.h"
+#include <string>
+
+int main()
+{
+	CHECK(ParseTimeOfDay("00:00:00.000") == 0);
+	CHECK(ParseTimeOfDay("23:59:59.999") == MsPerDay - 1);
+	CHECK(ParseTimeOfDay("12:34:56.789") == ((12 * 60 + 34) * 60 + 56) * 1000 + 789);
+	for (const char* bad : { "24:00:00.000", "12:60:00.000", "12:00:60.000", "1a:00:00.000", "12-00:00.000", "12:00:00,000", "12:00:00.0x0" })
+		CHECK(ParseTimeOfDay(bad) == -1);
+
+	CHECK(DaysFromCivil(1970, 1, 1) == 0);
+	CHECK(DaysFromCivil(2000, 3, 1) == 11017);
+	CHECK(ParseDate("2024-02-29") == DaysFromCivil(2024, 2, 29));
+	CHECK(ParseDate("2024/02/29") == -1);
+
+	// every millisecond of a day goes to text and back
+	for (int ms = 0; ms < MsPerDay; ms += 997)
+		CHECK(ParseTimeOfDay(TimeText(ms).c_str()) == ms);
+	CHECK(std::string(TimeText(-1).c_str()).empty());
+
+	printf("logtime: ok\n");
+	return 0;
+}
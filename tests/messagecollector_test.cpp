@@ -0,0 +1,159 @@
+#include "messagecollector.h"
+#include "check.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+// The three logs are parsed on their own threads and only meet on a shard when they
+// touch the same message, so this has writers feeding all three log types for the
+// same messages while a reader keeps its list up to date.
+// How fast they parse is in mlog_bench, this only checks what the reader sees.
+
+// the collector logs what it expires, there's no debugger to send it to here
+void DLog(const char*, ...)
+{
+}
+
+static std::string Name(uint64_t i)
+{
+	char name[16];
+	snprintf(name, sizeof(name), "B%012llX", (unsigned long long)i);
+	return name;
+}
+
+static LogEntry Line(MessageCollector::LogType logType, uint64_t message, int time)
+{
+	LogEntry entry;
+	entry.day = 20000;
+	entry.time = time;
+	switch (logType) {
+	case MessageCollector::LogType::receiver:
+		entry.body = "TX: <250 " + Name(message) + " Message accepted for delivery>";
+		break;
+	case MessageCollector::LogType::engine:
+		entry.body = "Processing " + Name(message) + ".0123456789ab.cdef.mml";
+		break;
+	case MessageCollector::LogType::sender:
+		entry.body = "Sent " + Name(message) + ".0123456789ab.cdef.mml";
+		break;
+	}
+	return entry;
+}
+
+// a copy is never seen half way through an update, every line it has is its own and
+// the times it took from them are the latest line's
+static void CheckCopy(const MessageInfo& info)
+{
+	auto name = info.MessageName();
+	for (auto logs : { &info.rxLogs, &info.engLogs, &info.txLogs }) {
+		for (const auto& entry : *logs)
+			CHECK(entry->body.find(name) != std::string::npos);
+	}
+	CHECK(info.rxLogs.empty() || info.rxTime == info.rxLogs.back()->time);
+	CHECK(info.engLogs.empty() || info.engTimeLatest == info.engLogs.back()->time);
+	CHECK(info.txLogs.empty() || info.txTimeLatest == info.txLogs.back()->time);
+}
+
+// oldest first with no message twice
+static void CheckOrder(const MessageList& buf)
+{
+	FlatMap<bool> seen;
+	for (size_t i = 0; i < buf.size(); i++) {
+		CHECK(i == 0 || buf[i - 1]->generation < buf[i]->generation);
+		CHECK(seen.Find(buf[i]->messageId) == nullptr);
+		seen[buf[i]->messageId] = true;
+	}
+}
+
+// a few lines at a time, so the list is mostly kept up to date by moving the ones
+// that changed and dropping the ones that expired, and it has to match a fresh
+// fill every time
+static void Steps()
+{
+	MessageLimits limits;
+	limits.maxMessages = 1024;
+	MessageCollector collector(limits);
+	MessageList buf;
+	std::mt19937 rng(99);
+	for (int step = 0; step < 5000; step++) {
+		for (int i = 0; i < 8; i++) {
+			auto logType = (MessageCollector::LogType)(rng() % 3);
+			auto line = Line(logType, 1 + rng() % 3000, step % MsPerDay);
+			collector.Parse(logType, LogEntrySpan(&line, 1));
+		}
+		CHECK(collector.FillBuffer(buf));
+		MessageList fresh;
+		collector.FillBuffer(fresh);
+		CHECK(buf.size() == fresh.size());
+		for (size_t i = 0; i < buf.size(); i++)
+			CHECK(buf[i] == fresh[i]);
+	}
+	CHECK(!collector.FillBuffer(buf));
+	printf("messagecollector: %zu messages after the steps, ok\n", buf.size());
+}
+
+static void Run(int writers, int linesEach)
+{
+	// few enough that they expire while the reader's behind
+	MessageLimits limits;
+	limits.maxMessages = 8192;
+	MessageCollector collector(limits);
+
+	// each writer's messages are shared with the two after it, under a different log type
+	std::vector<std::vector<LogEntry>> lines(writers);
+	for (int w = 0; w < writers; w++) {
+		std::mt19937 rng(w);
+		auto logType = (MessageCollector::LogType)(w % 3);
+		for (int i = 0; i < linesEach; i++)
+			lines[w].push_back(Line(logType, 1 + rng() % 20000, i % MsPerDay));
+	}
+
+	std::atomic<int> running(writers);
+	std::atomic<uint64_t> fills(0);
+	MessageList buf;
+	std::thread reader([&]() {
+		while (running > 0) {
+			if (collector.FillBuffer(buf)) {
+				CheckOrder(buf);
+				for (size_t i = 0; i < buf.size(); i++)
+					CheckCopy(*buf[i]);
+			}
+			fills++;
+		}
+	});
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < writers; w++) {
+		threads.emplace_back([&, w]() {
+			// a batch at a time the way the dispatchers are handed them
+			auto logType = (MessageCollector::LogType)(w % 3);
+			for (size_t i = 0; i < lines[w].size(); i += 64) {
+				size_t count = std::min<size_t>(64, lines[w].size() - i);
+				collector.Parse(logType, LogEntrySpan(&lines[w][i], count));
+			}
+			running--;
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	reader.join();
+
+	// caught up it's the same as a fresh fill, down to sharing the copies
+	collector.FillBuffer(buf);
+	MessageList fresh;
+	CHECK(collector.FillBuffer(fresh));
+	CHECK(buf.size() == fresh.size() && buf.size() == collector.NumMessages());
+	for (size_t i = 0; i < buf.size(); i++)
+		CHECK(buf[i] == fresh[i]);
+	CHECK(!collector.FillBuffer(buf));
+	printf("messagecollector: %d writers, %llu fills, %zu messages, ok\n", writers, (unsigned long long)fills.load(), buf.size());
+}
+
+int main()
+{
+	Steps();
+	for (int writers : { 1, 3, 6 })
+		Run(writers, 50000);
+	return 0;
+}
@@ -0,0 +1,47 @@
+#include "messageflow.h"
+#include "check.h"
+#include <cmath>
+
+static void Clock()
+{
+	LogClock clock;
+	CHECK(clock.Now() == -1);
+	clock.Observe(LogClock::Second(20000, 5000));
+	clock.Observe(LogClock::Second(20000, 1000));	// only goes forward
+	CHECK(clock.Now() >= 20000LL * 86400 + 5 && clock.Now() <= 20000LL * 86400 + 6);
+}
+
+// a log from years ago at a steady 10 messages a second, the rates are by its
+// clock so the host's being far ahead of it makes no difference
+static void Rates()
+{
+	MessageFlow flow;
+	const int Day = 10000;
+	for (int second = 0; second < 600; second++) {
+		for (int i = 0; i < 10; i++) {
+			flow.Enter(MessageFlow::received, Day, second * 1000 + i * 100);
+			flow.Move(-1, MessageFlow::received);
+		}
+		for (int i = 0; i < 8; i++) {
+			flow.Enter(MessageFlow::engine, Day, second * 1000 + i * 125);
+			flow.Move(MessageFlow::received, MessageFlow::engine);
+		}
+	}
+	auto figures = flow.GetFigures();
+	CHECK(std::fabs(figures.rate[MessageFlow::received] - 10) < 0.5);
+	CHECK(std::fabs(figures.rate[MessageFlow::engine] - 8) < 0.5);
+	CHECK(figures.rate[MessageFlow::sent] == 0);
+	CHECK(std::fabs(figures.hourRate[MessageFlow::received] - 10) < 0.1);
+	CHECK(figures.awaitingEngine == 600 * 2 && figures.inEngine == 600 * 8);
+
+	flow.Forget(MessageFlow::engine);
+	CHECK(flow.GetFigures().inEngine == 600 * 8 - 1);
+}
+
+int main()
+{
+	Clock();
+	Rates();
+	printf("messageflow: ok\n");
+	return 0;
+}
@@ -0,0 +1,26 @@
+#include "messageid.h"
+#include "check.h"
+#include <random>
+
+int main()
+{
+	for (const char* name : { "B5f3e6c1a0d42", "A000000000000", "EFFFFFFFFFFFF", "CabcdefABCDEF" })
+		CHECK(UnpackMessageId(PackMessageId(std::string(name))) == name);
+	for (const char* name : { "F5f3e6c1a0d42", "B5f3e6c1a0d4", "B5f3e6c1a0d4g", "" })
+		CHECK(PackMessageId(std::string(name)) == 0);
+
+	// the case of each digit is kept, so names differing only in case are different keys
+	CHECK(PackMessageId(std::string("Babcdef012345")) != PackMessageId(std::string("BABCDEF012345")));
+
+	std::mt19937 rng(3);
+	const char Digits[] = "0123456789abcdefABCDEF";
+	for (int i = 0; i < 100000; i++) {
+		std::string name(1, (char)('A' + rng() % 5));
+		for (int j = 0; j < 12; j++)
+			name += Digits[rng() % 22];
+		auto id = PackMessageId(name);
+		CHECK(id != 0 && UnpackMessageId(id) == name);
+	}
+	printf("messageid: ok\n");
+	return 0;
+}
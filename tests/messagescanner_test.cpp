@@ -0,0 +1,96 @@
+#include "messagescanner.h"
+#include "check.h"
+#include <boost/regex.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+// the scanner replaced these patterns, it has to agree with them on any line
+
+static uint64_t MessageIdOf(const boost::ssub_match& match)
+{
+	return match.length() == (ptrdiff_t)MessageNameLength ? PackMessageId(&*match.first) : 0;
+}
+
+static MessageLine MatchMessageLine(const std::string& body)
+{
+	static const boost::regex msgPattern("([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml");
+
+	MessageLine line;
+	boost::smatch match;
+	if (boost::regex_search(body, match, msgPattern)) {
+		line.kind = MessageLine::Kind::mentioned;
+		line.messageId = MessageIdOf(match[1]);
+	}
+	return line;
+}
+
+static MessageLine MatchReceiverLine(const std::string& body)
+{
+	static const boost::regex arrivePattern("^TX:\\s<250\\s(\\w+)\\sMessage\\saccepted\\sfor\\sdelivery>$");
+	static const boost::regex spamProfilerPattern("^([A-E][\\da-fA-F]{12})\\.[\\da-fA-F]{12}\\.[\\da-fA-F]{4}\\.mml\\sSpamProfiler\\sscore:\\s(\\d+),\\srescan:\\s(\\d+),\\sbulk:\\s(\\d+)");
+
+	MessageLine line;
+	boost::smatch match;
+	if (boost::regex_search(body, match, arrivePattern)) {
+		line.kind = MessageLine::Kind::arrived;
+		line.messageId = MessageIdOf(match[1]);
+	}
+	else if (boost::regex_search(body, match, spamProfilerPattern)) {
+		line.kind = MessageLine::Kind::spamProfiler;
+		line.messageId = MessageIdOf(match[1]);
+		line.spamProfilerScore = std::stoi(match[2].str());
+		line.spamProfilerRescan = std::stoi(match[3].str());
+		line.spamProfilerBulk = std::stoi(match[4].str());
+	}
+	else {
+		line = MatchMessageLine(body);
+	}
+	return line;
+}
+
+static bool Same(const MessageLine& lhs, const MessageLine& rhs)
+{
+	return lhs.kind == rhs.kind && lhs.messageId == rhs.messageId && lhs.spamProfilerScore == rhs.spamProfilerScore
+		&& lhs.spamProfilerRescan == rhs.spamProfilerRescan && lhs.spamProfilerBulk == rhs.spamProfilerBulk;
+}
+
+int main()
+{
+	// lines glued together from the pieces that matter, with stray characters
+	// and now and then one taken out, so they're near misses as often as not
+	std::mt19937 rng(7);
+	const std::string alphabet = "ABCDEFabcdef0123456789.mlX _:<>,\t";
+	const std::vector<std::string> pieces = { "TX: <250 ", " Message accepted for delivery>", "TX:\t<250\t", "B5f3e6c1a0d42",
+		"F5f3e6c1a0d42", ".0123456789ab.cdef.mml", ".0123456789aB.cdEf.mml", " SpamProfiler score: ", ", rescan: ", ", bulk: ",
+		"12", "0", ".mml", "A0000000000000", "x", " ", "Message", "AB5f3e6c1a0d42.0123456789ab.cdef.mml" };
+	int found = 0;
+	for (int i = 0; i < 100000; i++) {
+		std::string body;
+		for (int n = rng() % 8; n > 0; n--) {
+			if (rng() % 3 == 0)
+				body += alphabet[rng() % alphabet.size()];
+			else
+				body += pieces[rng() % pieces.size()];
+		}
+		if (rng() % 5 == 0 && !body.empty())
+			body.erase(rng() % body.size(), 1);
+
+		auto line = ScanReceiverLine(body.data(), body.size());
+		if (!Same(line, MatchReceiverLine(body))) {
+			fprintf(stderr, "receiver line disagrees: %s\n", body.c_str());
+			return 1;
+		}
+		MessageLine mentioned;
+		mentioned.messageId = FindMessageId(body.data(), body.size());
+		if (mentioned.messageId != 0)
+			mentioned.kind = MessageLine::Kind::mentioned;
+		if (!Same(mentioned, MatchMessageLine(body))) {
+			fprintf(stderr, "message line disagrees: %s\n", body.c_str());
+			return 1;
+		}
+		found += line.kind != MessageLine::Kind::none;
+	}
+	printf("messagescanner: %d of 100000 lines had a message, ok\n", found);
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include "seqring.h"
+#include "check.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Item
+{
+	uint64_t seq;
+	uint64_t check;		// derived from seq, a torn or freed item won't match
+	std::atomic<int>* live;
+
+	Item(uint64_t s, std::atomic<int>* l) : seq(s), check(s * 0x9e3779b97f4a7c15ull), live(l) { (*live)++; }
+	~Item() { check = 0; (*live)--; }
+};
+
+static void Basics()
+{
+	std::atomic<int> live(0);
+	{
+		SeqRing<Item> ring(4);
+		for (uint64_t i = 0; i < 6; i++)
+			ring.Push(std::make_shared<Item>(i, &live));
+		CHECK(ring.Head() == 6 && ring.Tail() == 2 && ring.Size() == 4);
+		{
+			SeqRing<Item>::Reader reader(ring);
+			CHECK(reader.Get(1) == nullptr);
+			for (uint64_t i = 2; i < 6; i++)
+				CHECK(reader.Get(i) != nullptr && reader.Get(i)->seq == i);
+		}
+		ring.Drop();
+		CHECK(ring.Tail() == 3);
+		SeqRing<Item>::Reader reader(ring);
+		CHECK(reader.Get(2) == nullptr && reader.Get(3)->seq == 3);
+	}
+	CHECK(live == 0);
+}
+
+// dropped items are counted until no reader could be holding them
+static void Weights()
+{
+	std::atomic<int> live(0);
+	{
+		SeqRing<Item> ring(4);
+		for (uint64_t i = 0; i < 4; i++)
+			ring.Push(std::make_shared<Item>(i, &live), 10);
+		CHECK(ring.Weight() == 40 && ring.RetiredWeight() == 0);
+		ring.Drop();
+		CHECK(ring.Weight() == 30 && ring.RetiredWeight() == 0 && live == 3);
+		{
+			SeqRing<Item>::Reader reader(ring);
+			ring.Drop();
+			ring.Push(std::make_shared<Item>(4, &live), 10);
+			CHECK(ring.Weight() == 40 && ring.RetiredWeight() == 10 && live == 4);
+			ring.Reclaim();
+			CHECK(ring.RetiredWeight() == 10 && live == 4);
+		}
+		ring.Reclaim();
+		CHECK(ring.Weight() == 30 && ring.RetiredWeight() == 0 && live == 3);
+		// overwritten rather than dropped
+		for (uint64_t i = 5; i < 7; i++)
+			ring.Push(std::make_shared<Item>(i, &live), 5);
+		CHECK(ring.Size() == 4 && ring.RetiredWeight() == 10);
+		ring.Reclaim();
+		CHECK(ring.Weight() == 30 && ring.RetiredWeight() == 0);
+	}
+	CHECK(live == 0);
+}
+
+// one writer pushing and dropping as fast as it can, readers checking every item they
+// can still see is the one for its sequence and isn't freed while they hold it
+static void Stress(int readers, uint64_t pushes)
+{
+	std::atomic<int> live(0);
+	std::atomic<bool> done(false);
+	std::atomic<uint64_t> seen(0);
+	{
+		SeqRing<Item> ring(64);
+		std::vector<std::thread> threads;
+		for (int r = 0; r < readers; r++) {
+			threads.emplace_back([&]() {
+				uint64_t count = 0;
+				while (!done) {
+					SeqRing<Item>::Reader reader(ring);
+					CHECK(reader.Tail() <= reader.Head() && reader.Size() <= ring.Capacity());
+					for (uint64_t seq = reader.Tail(); seq < reader.Head(); seq++) {
+						const Item* item = reader.Get(seq);
+						if (item == nullptr)
+							continue;	// overwritten since
+						CHECK(item->seq == seq);
+						CHECK(item->check == seq * 0x9e3779b97f4a7c15ull);
+						count++;
+					}
+				}
+				seen += count;
+			});
+		}
+		for (uint64_t i = 0; i < pushes; i++) {
+			ring.Push(std::make_shared<Item>(i, &live));
+			if (i % 7 == 0)
+				ring.Drop();
+		}
+		done = true;
+		for (auto& thread : threads)
+			thread.join();
+	}
+	CHECK(live == 0);
+	printf("seqring: %d readers checked %llu items\n", readers, (unsigned long long)seen.load());
+}
+
+int main()
+{
+	Basics();
+	Weights();
+	for (int readers : { 1, 4, 15 })
+		Stress(readers, 200000);
+	printf("seqring: ok\n");
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include "timerwheel.h"
+#include "check.h"
+#include <random>
+#include <vector>
+
+// random schedules, cancels and advances against a plain list of expiry times, every
+// timer has to fire in the second it's due (or the next one if it was already due)
+int main()
+{
+	std::mt19937_64 rng(7);
+	for (int round = 0; round < 10; round++) {
+		TimerWheel wheel;
+		const int N = 500;
+		std::vector<WheelTimer> timers(N);
+		std::vector<int64_t> due(N, -1);
+		int64_t now = 1000000000 + (int64_t)(rng() % 100000);
+		wheel.Advance(now, [](WheelTimer&) {});
+		for (int step = 0; step < 10000; step++) {
+			int i = (int)(rng() % N);
+			switch (rng() % 10) {
+			case 0: case 1: case 2: case 3: case 4: {
+				// now and then past the top wheel's range
+				int64_t span = rng() % 4 == 0 ? (int64_t)(rng() % 20000000) : (int64_t)(rng() % 2000);
+				int64_t expires = now + span - 5;
+				timers[i].key = i;
+				wheel.Schedule(timers[i], expires);
+				due[i] = expires <= now ? now + 1 : expires;
+				break;
+			}
+			case 5: case 6:
+				wheel.Cancel(timers[i]);
+				due[i] = -1;
+				break;
+			default: {
+				int64_t to = now + (rng() % 50 == 0 ? (int64_t)(rng() % 500000) : (int64_t)(rng() % 30));
+				wheel.Advance(to, [&](WheelTimer& timer) {
+					CHECK(!timer.Scheduled());
+					CHECK(due[timer.key] == wheel.Now());
+					due[timer.key] = -1;
+				});
+				now = to;
+				for (auto d : due)
+					CHECK(d < 0 || d > now);
+				break;
+			}
+			}
+			size_t scheduled = 0;
+			for (auto d : due)
+				scheduled += d >= 0;
+			CHECK(scheduled == wheel.Size());
+		}
+	}
+	printf("timerwheel: ok\n");
+	return 0;
+}
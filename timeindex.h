@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// Checkpoints of the time every so many lines, so the line at a time can be found
+// with a binary search and a short scan rather than by reading every line. A
+// checkpoint's stamp is the latest of all the lines up to it, so they only go
+// forward even when threads log a little out of order.
+class TimeIndex
+{
+	struct Checkpoint
+	{
+		int64_t stamp;
+		uint64_t line;
+	};
+
+	mutable std::mutex lock_;
+	std::deque<Checkpoint> checkpoints_;
+	int64_t maxStamp_ = -1;		// writer only
+
+public:
+	static const uint64_t EveryLines = 256;
+	static const int64_t EveryMs = 1000;
+
+	// writer only, line has a time
+	void Add(uint64_t line, int64_t stamp)
+	{
+		maxStamp_ = std::max(maxStamp_, stamp);
+		std::lock_guard<std::mutex> guard(lock_);
+		if (!checkpoints_.empty()) {
+			const auto& last = checkpoints_.back();
+			if (line - last.line < EveryLines && maxStamp_ - last.stamp < EveryMs)
+				return;
+		}
+		checkpoints_.push_back({ maxStamp_, line });
+	}
+
+	// writer only, the lines before line have gone
+	void DropBefore(uint64_t line)
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		while (!checkpoints_.empty() && checkpoints_.front().line < line)
+			checkpoints_.pop_front();
+	}
+
+	// every line before the one returned is earlier than stamp, first if there's
+	// no checkpoint to go by, the line we want is at most a checkpoint further on
+	uint64_t Find(int64_t stamp, uint64_t first) const
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		auto it = std::lower_bound(checkpoints_.begin(), checkpoints_.end(), stamp,
+			[](const Checkpoint& checkpoint, int64_t stamp) { return checkpoint.stamp < stamp; });
+		if (it == checkpoints_.begin())
+			return first;
+		return std::max(first, (it - 1)->line + 1);
+	}
+};
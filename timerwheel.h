@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A deadline on a TimerWheel, kept in whatever it's the deadline for
+struct WheelTimer
+{
+	WheelTimer* next = nullptr;
+	WheelTimer* prev = nullptr;
+	int64_t expires = 0;		// in seconds
+	uint64_t key = 0;			// what it's for, for whoever it fires for
+
+	bool Scheduled() const { return prev != nullptr; }
+};
+
+// A hierarchical timer wheel in whole seconds. Each of the Levels wheels has Slots
+// slots and covers Slots times the span of the one below it, a timer goes in the
+// lowest wheel it fits and moves down a wheel each time the one below comes round
+// to it. Scheduling and cancelling are a link and unlink, and a second passing
+// only looks at the timers due in it, however many there are. Not thread safe.
+class TimerWheel
+{
+	static const int SlotBits = 6;
+	static const int Slots = 1 << SlotBits;
+	static const int Levels = 4;		// about 194 days, anything later goes round the top wheel again
+
+	WheelTimer slots_[Levels][Slots];	// the heads of circular lists
+	int64_t now_ = -1;					// the last second that's been handled
+	size_t count_ = 0;
+
+public:
+	TimerWheel()
+	{
+		for (auto& level : slots_) {
+			for (auto& slot : level)
+				slot.next = slot.prev = &slot;
+		}
+	}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	int64_t Now() const { return now_; }
+	size_t Size() const { return count_; }
+
+	// anything already due fires the next time the wheel moves on, the wheel
+	// starts from the first Advance or the first Schedule, whichever comes first
+	void Schedule(WheelTimer& timer, int64_t expires)
+	{
+		Cancel(timer);
+		if (now_ < 0)
+			now_ = expires - 1;
+		timer.expires = expires;
+		Insert(timer, now_ + 1);
+		count_++;
+	}
+
+	void Cancel(WheelTimer& timer)
+	{
+		if (!timer.Scheduled())
+			return;
+		Unlink(timer);
+		count_--;
+	}
+
+	// moves on to now, fire(WheelTimer&) is called for each timer that's due
+	// after it's taken off the wheel, so it can be scheduled again
+	template <typename F>
+	void Advance(int64_t now, F&& fire)
+	{
+		if (now_ < 0 || count_ == 0) {
+			if (now > now_)
+				now_ = now;
+			return;
+		}
+		while (now_ < now && count_ > 0) {
+			int64_t second = now_ + 1;
+			// the higher wheels come down first, so what they hold can carry on down
+			for (int level = Levels - 1; level > 0; level--) {
+				if ((second & ((1LL << level * SlotBits) - 1)) == 0)
+					Cascade(level, second);
+			}
+			now_ = second;
+
+			auto& head = slots_[0][second & (Slots - 1)];
+			while (head.next != &head) {
+				auto& timer = *head.next;
+				Unlink(timer);
+				count_--;
+				fire(timer);
+			}
+		}
+		if (now > now_)
+			now_ = now;
+	}
+
+private:
+	// base is the next second the wheel will fire, anything due before then fires in it
+	void Insert(WheelTimer& timer, int64_t base)
+	{
+		int64_t expires = timer.expires > base ? timer.expires : base;
+		int level = 0;
+		while (level < Levels - 1 && (expires >> (level + 1) * SlotBits) != (base >> (level + 1) * SlotBits))
+			level++;
+		Link(slots_[level][(expires >> level * SlotBits) & (Slots - 1)], timer);
+	}
+
+	// the slot in level that's come round moves down to the wheels below
+	void Cascade(int level, int64_t second)
+	{
+		auto& head = slots_[level][(second >> level * SlotBits) & (Slots - 1)];
+		WheelTimer pending;
+		if (head.next == &head)
+			return;
+		pending.next = head.next;
+		pending.prev = head.prev;
+		pending.next->prev = pending.prev->next = &pending;
+		head.next = head.prev = &head;
+
+		while (pending.next != &pending) {
+			auto& timer = *pending.next;
+			Unlink(timer);
+			Insert(timer, second);
+		}
+	}
+
+	static void Link(WheelTimer& head, WheelTimer& timer)
+	{
+		timer.prev = head.prev;
+		timer.next = &head;
+		head.prev->next = &timer;
+		head.prev = &timer;
+	}
+
+	static void Unlink(WheelTimer& timer)
+	{
+		timer.prev->next = timer.next;
+		timer.next->prev = timer.prev;
+		timer.next = timer.prev = nullptr;
+	}
+};
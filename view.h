@@ -37,6 +37,8 @@ public:
 
 	virtual const std::string& GetCurrentSearchPattern() const { return searchPattern_; }
 	virtual void SetSearchPattern(const std::string& searchPattern) { searchPattern_ = searchPattern; }
+	// time is milliseconds since midnight, false if the view can't go to a time
+	virtual bool GotoTime(int time) { return false; }
 };
 
 typedef std::shared_ptr<View> ViewPtr;
@@ -0,0 +1,74 @@
+#include "workpool.h"
+
+WorkPool::WorkPool(unsigned threads)
+	: next_(0), exiting_(false), queued_(0)
+{
+	for (unsigned i = 0; i < std::max(1u, threads); i++)
+		workers_.emplace_back(new Worker);
+	for (unsigned i = 0; i < workers_.size(); i++)
+		workers_[i]->thread = std::thread(&WorkPool::Run, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+	Shutdown();
+}
+
+void WorkPool::Submit(Task task)
+{
+	auto& worker = *workers_[next_++ % workers_.size()];
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		worker.tasks.push_back(std::move(task));
+	}
+	{
+		// taken so a thread that's about to wait can't miss the notify
+		std::lock_guard<std::mutex> guard(idleLock_);
+		queued_++;
+	}
+	idle_.notify_one();
+}
+
+void WorkPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> guard(idleLock_);
+		if (exiting_)
+			return;
+		exiting_ = true;
+	}
+	idle_.notify_all();
+	for (auto& worker : workers_) {
+		if (worker->thread.joinable())
+			worker->thread.join();
+	}
+}
+
+// our own queue first, then the oldest task from someone else's
+bool WorkPool::Take(unsigned self, Task& task)
+{
+	for (size_t i = 0; i < workers_.size(); i++) {
+		auto& worker = *workers_[(self + i) % workers_.size()];
+		std::lock_guard<std::mutex> guard(worker.lock);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			queued_--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkPool::Run(unsigned self)
+{
+	while (!exiting_) {
+		Task task;
+		if (Take(self, task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(idleLock_);
+		idle_.wait(guard, [this]() { return exiting_ || queued_ > 0; });
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small pool of threads, each with its own queue of tasks. Tasks are handed
+// out round robin and a thread that runs out of its own takes the oldest task
+// from another one, so a slow task only holds up the tasks queued behind it
+// until another thread is free to take them.
+class WorkPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	explicit WorkPool(unsigned threads);
+	~WorkPool();
+
+	WorkPool(const WorkPool&) = delete;
+	WorkPool& operator=(const WorkPool&) = delete;
+
+	unsigned Threads() const { return (unsigned)workers_.size(); }
+	void Submit(Task task);
+	// waits for the running tasks, the queued ones are dropped
+	void Shutdown();
+
+private:
+	struct Worker
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::atomic<unsigned> next_;
+	std::atomic<bool> exiting_;
+	std::mutex idleLock_;
+	std::condition_variable idle_;
+	std::atomic<int> queued_;	// tasks waiting in any queue, so an idle thread knows to look
+
+	void Run(unsigned self);
+	bool Take(unsigned self, Task& task);
+};